@@ -0,0 +1,324 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformMeshBenchmark.h"
+#include "DeformMeshTransformReplay.h"
+#include "Engine/World.h"
+#include "Engine/StaticMesh.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/DateTime.h"
+#include "RenderCore.h"
+#include "RenderingThread.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonWriter.h"
+#include "Serialization/JsonSerializer.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogDeformMeshBenchmark, Log, All);
+
+// Sets default values
+ADeformMeshBenchmark::ADeformMeshBenchmark()
+	: GridX(8)
+	, GridY(8)
+	, SectionsPerComponent(4)
+	, Spacing(300.f)
+	, WarmupFrames(30)
+	, MeasuredFrames(300)
+	, Mesh(nullptr)
+	, bExitWhenDone(false)
+	, ProxyRebuildMs(0.0)
+	, UsedMemoryBeforeSpawn(0)
+	, UsedMemoryAfterWarmup(0)
+	, FrameCounter(0)
+	, ElapsedTime(0.f)
+	, bFinished(false)
+{
+	PrimaryActorTick.bCanEverTick = true;
+	//We drive the transforms before the components are ticked, like a gameplay actor would do
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+}
+
+// Called when the game starts or when spawned
+void ADeformMeshBenchmark::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!Mesh)
+	{
+		Mesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	}
+
+	//Every section of the grid is created from the mesh, there's nothing to measure without one
+	if (!Mesh)
+	{
+		UE_LOG(LogDeformMeshBenchmark, Error, TEXT("No mesh to create the sections from, the benchmark is aborted"));
+		bFinished = true;
+		if (bExitWhenDone)
+		{
+			FPlatformMisc::RequestExit(false);
+		}
+		return;
+	}
+
+	if (!ReplayFile.IsEmpty())
+	{
+		Replay = MakeShared<FDeformMeshTransformReplay>();
+		if (!Replay->Open(ReplayFile))
+		{
+			UE_LOG(LogDeformMeshBenchmark, Warning, TEXT("Can't replay %s, using the synthetic motion instead"), *ReplayFile);
+			Replay.Reset();
+		}
+	}
+
+	//The resident memory is sampled at the end of the last warmup frame, so there's always at least one
+	WarmupFrames = FMath::Max(WarmupFrames, 1);
+
+	UsedMemoryBeforeSpawn = FPlatformMemory::GetStats().UsedPhysical;
+	SpawnGrid();
+
+	GameThreadMs.Reserve(MeasuredFrames);
+	RenderThreadMs.Reserve(MeasuredFrames);
+	UpdateMs.Reserve(MeasuredFrames);
+
+	UE_LOG(LogDeformMeshBenchmark, Log, TEXT("Started: %d components, %d sections each, %d warmup frames, %d measured frames"),
+		Components.Num(), SectionsPerComponent, WarmupFrames, MeasuredFrames);
+}
+
+// Called every frame
+void ADeformMeshBenchmark::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (bFinished)
+	{
+		return;
+	}
+
+	//We use a fixed time step, so two runs with a different frame rate still produce the same motion
+	ElapsedTime += 1.f / 60.f;
+
+	const double UpdateStart = FPlatformTime::Seconds();
+	DriveTransforms(ElapsedTime);
+	const double UpdateEnd = FPlatformTime::Seconds();
+
+	FrameCounter++;
+	if (FrameCounter == WarmupFrames)
+	{
+		//All the proxies exist now, so this is the resident cost of the grid
+		FlushRenderingCommands();
+		UsedMemoryAfterWarmup = FPlatformMemory::GetStats().UsedPhysical;
+	}
+	else if (FrameCounter > WarmupFrames)
+	{
+		//The engine globals hold the times of the previous frame, which is fine since we're only looking at the distribution
+		GameThreadMs.Add(FPlatformTime::ToMilliseconds(GGameThreadTime));
+		RenderThreadMs.Add(FPlatformTime::ToMilliseconds(GRenderThreadTime));
+		UpdateMs.Add((UpdateEnd - UpdateStart) * 1000.0);
+
+		if (GameThreadMs.Num() >= MeasuredFrames)
+		{
+			MeasureProxyRebuilds();
+			WriteReport();
+		}
+	}
+}
+
+void ADeformMeshBenchmark::SpawnGrid()
+{
+	UWorld* World = GetWorld();
+	check(World);
+
+	for (int32 X = 0; X < GridX; X++)
+	{
+		for (int32 Y = 0; Y < GridY; Y++)
+		{
+			const FVector Location = GetActorLocation() + FVector(X * Spacing, Y * Spacing, 0.f);
+
+			AActor* Owner = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform(Location));
+			UDeformMeshComponent* DeformMeshComp = NewObject<UDeformMeshComponent>(Owner, TEXT("DeformMeshComp"));
+			Owner->SetRootComponent(DeformMeshComp);
+			DeformMeshComp->SetWorldLocation(Location);
+			DeformMeshComp->RegisterComponent();
+
+			for (int32 SectionIdx = 0; SectionIdx < SectionsPerComponent; SectionIdx++)
+			{
+				DeformMeshComp->CreateMeshSection(SectionIdx, Mesh, FTransform(Location));
+			}
+
+			Components.Add(DeformMeshComp);
+		}
+	}
+}
+
+void ADeformMeshBenchmark::DriveTransforms(float Time)
+{
+	if (Replay.IsValid())
+	{
+		//Every component gets the same recorded frame
+		for (UDeformMeshComponent* DeformMeshComp : Components)
+		{
+			Replay->ApplyCurrentFrame(DeformMeshComp);
+		}
+		Replay->AdvanceFrame();
+		return;
+	}
+
+	for (int32 CompIdx = 0; CompIdx < Components.Num(); CompIdx++)
+	{
+		UDeformMeshComponent* DeformMeshComp = Components[CompIdx];
+		const FVector Origin = DeformMeshComp->GetComponentLocation();
+
+		for (int32 SectionIdx = 0; SectionIdx < SectionsPerComponent; SectionIdx++)
+		{
+			//Every section gets its own phase so the updates are not all identical
+			const float Phase = Time * 2.f + CompIdx * 0.37f + SectionIdx * 1.3f;
+			const FTransform Transform(
+				FRotator(0.f, FMath::RadiansToDegrees(Phase), 0.f),
+				Origin + FVector(FMath::Sin(Phase), FMath::Cos(Phase), 0.f) * 50.f,
+				FVector(1.f + 0.25f * FMath::Sin(Phase * 0.5f)));
+
+			DeformMeshComp->UpdateMeshSectionTransform(SectionIdx, Transform);
+		}
+		DeformMeshComp->FinishTransformsUpdate();
+	}
+}
+
+void ADeformMeshBenchmark::MeasureProxyRebuilds()
+{
+	//Make sure the render thread isn't behind, so we don't measure a stall caused by previous frames
+	FlushRenderingCommands();
+
+	const double Start = FPlatformTime::Seconds();
+	for (UDeformMeshComponent* DeformMeshComp : Components)
+	{
+		DeformMeshComp->RecreateRenderState_Concurrent();
+	}
+	FlushRenderingCommands();
+	ProxyRebuildMs = (FPlatformTime::Seconds() - Start) * 1000.0;
+}
+
+/* Adds the mean, median, 95th percentile and max of a series of timings to the report */
+static void AddSummary(TSharedRef<FJsonObject>& Report, const TCHAR* Name, TArray<float> Values)
+{
+	TSharedRef<FJsonObject> Summary = MakeShared<FJsonObject>();
+
+	if (Values.Num() > 0)
+	{
+		double Sum = 0.0;
+		for (float Value : Values)
+		{
+			Sum += Value;
+		}
+
+		TArray<TSharedPtr<FJsonValue>> Frames;
+		Frames.Reserve(Values.Num());
+		for (float Value : Values)
+		{
+			Frames.Add(MakeShared<FJsonValueNumber>(Value));
+		}
+		Summary->SetArrayField(TEXT("Frames"), Frames);
+
+		Values.Sort();
+		Summary->SetNumberField(TEXT("Mean"), Sum / Values.Num());
+		Summary->SetNumberField(TEXT("Median"), Values[Values.Num() / 2]);
+		Summary->SetNumberField(TEXT("P95"), Values[FMath::Min(Values.Num() - 1, (Values.Num() * 95) / 100)]);
+		Summary->SetNumberField(TEXT("Max"), Values.Last());
+	}
+
+	Report->SetObjectField(Name, Summary);
+}
+
+void ADeformMeshBenchmark::WriteReport()
+{
+	bFinished = true;
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetNumberField(TEXT("GridX"), GridX);
+	Report->SetNumberField(TEXT("GridY"), GridY);
+	Report->SetNumberField(TEXT("Components"), Components.Num());
+	Report->SetNumberField(TEXT("SectionsPerComponent"), SectionsPerComponent);
+	Report->SetNumberField(TEXT("MeasuredFrames"), GameThreadMs.Num());
+	Report->SetStringField(TEXT("Mesh"), Mesh ? Mesh->GetPathName() : TEXT("None"));
+	Report->SetStringField(TEXT("Motion"), Replay.IsValid() ? ReplayFile : TEXT("Synthetic"));
+
+	AddSummary(Report, TEXT("GameThreadMs"), GameThreadMs);
+	AddSummary(Report, TEXT("RenderThreadMs"), RenderThreadMs);
+	AddSummary(Report, TEXT("UpdateMs"), UpdateMs);
+
+	Report->SetNumberField(TEXT("ProxyRebuildMs"), ProxyRebuildMs);
+	Report->SetNumberField(TEXT("ProxyRebuildMsPerComponent"), Components.Num() > 0 ? ProxyRebuildMs / Components.Num() : 0.0);
+
+	SIZE_T ResourceBytes = 0;
+	for (UDeformMeshComponent* DeformMeshComp : Components)
+	{
+		ResourceBytes += DeformMeshComp->GetResourceSizeBytes(EResourceSizeMode::EstimatedTotal);
+	}
+	Report->SetNumberField(TEXT("ComponentResourceBytes"), ResourceBytes);
+	Report->SetNumberField(TEXT("UsedPhysicalDeltaBytes"), (double)((int64)UsedMemoryAfterWarmup - (int64)UsedMemoryBeforeSpawn));
+
+	FString Output;
+	TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Output);
+	FJsonSerializer::Serialize(Report, Writer);
+
+	ReportFilename = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("DeformMeshBenchmark"),
+		FString::Printf(TEXT("DeformMeshBenchmark_%s.json"), *FDateTime::Now().ToString()));
+	FFileHelper::SaveStringToFile(Output, *ReportFilename);
+
+	UE_LOG(LogDeformMeshBenchmark, Display, TEXT("Report written to %s"), *ReportFilename);
+	UE_LOG(LogDeformMeshBenchmark, Display, TEXT("%s"), *Output);
+
+	if (bExitWhenDone)
+	{
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+/* Console command that spawns a benchmark actor in the current world, all the arguments are optional: GridX= GridY= Sections= Spacing= Warmup= Frames= Mesh= Replay= Exit= */
+static void StartDeformMeshBenchmark(const TArray<FString>& Args, UWorld* World)
+{
+	if (!World)
+	{
+		return;
+	}
+
+	const FString Params = FString::Join(Args, TEXT(" "));
+
+	//A mesh that can't be loaded aborts the benchmark, it's not replaced with the default one
+	UStaticMesh* Mesh = nullptr;
+	FString MeshPath;
+	if (FParse::Value(*Params, TEXT("Mesh="), MeshPath))
+	{
+		Mesh = LoadObject<UStaticMesh>(nullptr, *MeshPath);
+		if (!Mesh)
+		{
+			UE_LOG(LogDeformMeshBenchmark, Error, TEXT("Can't load the static mesh %s, the benchmark is aborted"), *MeshPath);
+			bool bExitWhenDone = false;
+			if (FParse::Bool(*Params, TEXT("Exit="), bExitWhenDone) && bExitWhenDone)
+			{
+				FPlatformMisc::RequestExit(false);
+			}
+			return;
+		}
+	}
+
+	ADeformMeshBenchmark* Benchmark = World->SpawnActorDeferred<ADeformMeshBenchmark>(ADeformMeshBenchmark::StaticClass(), FTransform::Identity);
+	Benchmark->Mesh = Mesh;
+	FParse::Value(*Params, TEXT("GridX="), Benchmark->GridX);
+	FParse::Value(*Params, TEXT("GridY="), Benchmark->GridY);
+	FParse::Value(*Params, TEXT("Sections="), Benchmark->SectionsPerComponent);
+	FParse::Value(*Params, TEXT("Spacing="), Benchmark->Spacing);
+	FParse::Value(*Params, TEXT("Warmup="), Benchmark->WarmupFrames);
+	FParse::Value(*Params, TEXT("Frames="), Benchmark->MeasuredFrames);
+	FParse::Value(*Params, TEXT("Replay="), Benchmark->ReplayFile);
+	FParse::Bool(*Params, TEXT("Exit="), Benchmark->bExitWhenDone);
+
+	Benchmark->FinishSpawning(FTransform::Identity);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GDeformMeshBenchmarkCommand(
+	TEXT("DeformMesh.Benchmark"),
+	TEXT("Spawns a grid of deform mesh components, drives their transforms and writes a JSON report to Saved/DeformMeshBenchmark.\n")
+	TEXT("Arguments: GridX= GridY= Sections= Spacing= Warmup= Frames= Mesh= Replay= Exit="),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StartDeformMeshBenchmark));
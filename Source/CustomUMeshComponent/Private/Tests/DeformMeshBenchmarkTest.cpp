@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DeformMeshBenchmark.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/*
+ * Runs a small benchmark grid in a transient game world and checks the JSON report
+ * Nothing is drawn, so it can run with -nullrhi:
+ * UE4Editor-Cmd CustomUMeshComponent -nullrhi -unattended -ExecCmds="Automation RunTests DeformMesh.Benchmark; Quit"
+*/
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDeformMeshBenchmarkReportTest, "DeformMesh.Benchmark.Report",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FDeformMeshBenchmarkReportTest::RunTest(const FString& Parameters)
+{
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+	World->BeginPlay();
+
+	ADeformMeshBenchmark* Benchmark = World->SpawnActorDeferred<ADeformMeshBenchmark>(ADeformMeshBenchmark::StaticClass(), FTransform::Identity);
+	Benchmark->GridX = 2;
+	Benchmark->GridY = 3;
+	Benchmark->SectionsPerComponent = 2;
+	Benchmark->WarmupFrames = 0;
+	Benchmark->MeasuredFrames = 8;
+	Benchmark->bExitWhenDone = false;
+	Benchmark->FinishSpawning(FTransform::Identity);
+
+	//The warmup is clamped to one frame, and the proxies are rebuilt once after the measured frames
+	for (int32 Frame = 0; Frame < 64 && !Benchmark->IsFinished(); Frame++)
+	{
+		World->Tick(LEVELTICK_All, 1.f / 60.f);
+	}
+
+	const bool bFinished = Benchmark->IsFinished();
+	const FString ReportFilename = Benchmark->GetReportFilename();
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+
+	if (!TestTrue(TEXT("The benchmark finished"), bFinished))
+	{
+		return false;
+	}
+
+	FString Output;
+	if (!TestTrue(TEXT("The report was written"), !ReportFilename.IsEmpty() && FFileHelper::LoadFileToString(Output, *ReportFilename)))
+	{
+		return false;
+	}
+
+	TSharedPtr<FJsonObject> Report;
+	if (!TestTrue(TEXT("The report is valid JSON"), FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(Output), Report) && Report.IsValid()))
+	{
+		return false;
+	}
+
+	TestEqual(TEXT("GridX"), (int32)Report->GetNumberField(TEXT("GridX")), 2);
+	TestEqual(TEXT("GridY"), (int32)Report->GetNumberField(TEXT("GridY")), 3);
+	TestEqual(TEXT("Components"), (int32)Report->GetNumberField(TEXT("Components")), 6);
+	TestEqual(TEXT("SectionsPerComponent"), (int32)Report->GetNumberField(TEXT("SectionsPerComponent")), 2);
+	TestEqual(TEXT("MeasuredFrames"), (int32)Report->GetNumberField(TEXT("MeasuredFrames")), 8);
+	TestEqual(TEXT("Motion"), Report->GetStringField(TEXT("Motion")), FString(TEXT("Synthetic")));
+
+	for (const TCHAR* SummaryName : { TEXT("GameThreadMs"), TEXT("RenderThreadMs"), TEXT("UpdateMs") })
+	{
+		const TSharedPtr<FJsonObject>* Summary = nullptr;
+		if (TestTrue(FString::Printf(TEXT("%s summary"), SummaryName), Report->TryGetObjectField(SummaryName, Summary)))
+		{
+			TestEqual(FString::Printf(TEXT("%s frames"), SummaryName), (*Summary)->GetArrayField(TEXT("Frames")).Num(), 8);
+			TestTrue(FString::Printf(TEXT("%s max"), SummaryName), (*Summary)->GetNumberField(TEXT("Max")) >= (*Summary)->GetNumberField(TEXT("Median")));
+		}
+	}
+
+	TestTrue(TEXT("ProxyRebuildMs"), Report->HasField(TEXT("ProxyRebuildMs")));
+	TestTrue(TEXT("ComponentResourceBytes"), Report->GetNumberField(TEXT("ComponentResourceBytes")) > 0.0);
+	TestTrue(TEXT("UsedPhysicalDeltaBytes"), Report->HasField(TEXT("UsedPhysicalDeltaBytes")));
+
+	return true;
+}
+
+#endif //WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Components/DeformMeshComponent.h"
+#include "DeformMeshBenchmark.generated.h"
+
+class FDeformMeshTransformReplay;
+
+
+UCLASS()
+class CUSTOMUMESHCOMPONENT_API ADeformMeshBenchmark : public AActor
+{
+	GENERATED_BODY()
+
+/*
+ * Headless benchmark of the deform mesh update path
+ * It spawns a grid of actors with a DeformMeshComponent each, drives the deform transforms of all their sections every frame,
+ * (Either with a synthetic motion, or by replaying a recorded transform stream), and writes the game thread time, render thread time, update time, proxy rebuild time and memory as JSON to Saved/DeformMeshBenchmark
+ * It doesn't need a GPU, so it can run on a build box with -nullrhi:
+ * UE4Editor-Cmd CustomUMeshComponent -game -nullrhi -unattended -ExecCmds="DeformMesh.Benchmark GridX=16 GridY=16 Sections=8 Frames=600 Exit=1"
+*/
+public:
+
+	// Sets default values for this actor's properties
+	ADeformMeshBenchmark();
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+public:
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	//Number of deform mesh actors on the X axis of the grid
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+		int32 GridX;
+
+	//Number of deform mesh actors on the Y axis of the grid
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+		int32 GridY;
+
+	//Number of mesh sections created in each deform mesh component
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+		int32 SectionsPerComponent;
+
+	//Distance between two neighbouring actors of the grid
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+		float Spacing;
+
+	//Frames that are simulated but not measured, so the proxies and the buffers are all created when we start measuring
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+		int32 WarmupFrames;
+
+	//Frames that are measured and reported
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+		int32 MeasuredFrames;
+
+	//The static mesh used by all the sections, the engine cube is used if this is not set
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+		UStaticMesh* Mesh;
+
+	//A transform stream recorded with DeformMesh.RecordTransforms, if set it's replayed on every component instead of the synthetic motion
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+		FString ReplayFile;
+
+	//Whether we should request the engine to exit when the report is written
+	UPROPERTY(EditAnywhere, Category = "Benchmark")
+		bool bExitWhenDone;
+
+	/* Whether the report was written, or the benchmark was aborted */
+	bool IsFinished() const { return bFinished; }
+
+	/* Path of the JSON report, empty until it's written */
+	const FString& GetReportFilename() const { return ReportFilename; }
+
+private:
+	/* Spawn the grid of deform mesh components and create their sections */
+	void SpawnGrid();
+
+	/* Update the deform transforms of all the sections using the replay if we have one, or using a synthetic motion otherwise */
+	void DriveTransforms(float Time);
+
+	/* Recreate the render state of every component once and measure the time it takes */
+	void MeasureProxyRebuilds();
+
+	/* Write the JSON report and exit if needed */
+	void WriteReport();
+
+	UPROPERTY(Transient)
+		TArray<UDeformMeshComponent*> Components;
+
+	//The mapped transform stream, when replaying
+	TSharedPtr<FDeformMeshTransformReplay> Replay;
+
+	//Per frame timings, in milliseconds
+	TArray<float> GameThreadMs;
+	TArray<float> RenderThreadMs;
+	TArray<float> UpdateMs;
+
+	//Total and per component time needed to rebuild the scene proxies, in milliseconds
+	double ProxyRebuildMs;
+
+	//Used physical memory before spawning the grid
+	uint64 UsedMemoryBeforeSpawn;
+	//Used physical memory after the warmup, when all the proxies are created
+	uint64 UsedMemoryAfterWarmup;
+
+	int32 FrameCounter;
+	float ElapsedTime;
+	bool bFinished;
+
+	FString ReportFilename;
+};
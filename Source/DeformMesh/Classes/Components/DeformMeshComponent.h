@@ -8,14 +8,61 @@
 #include "Components/MeshComponent.h"
 #include "PhysicsEngine/ConvexElem.h"
 #include "Engine/StaticMesh.h"
+#include "Components/SplineMeshComponent.h"
 #include "DeformMeshComponent.generated.h"
 
 //Forward declarations
 class FPrimitiveSceneProxy;
+struct FStreamableHandle;
+class UDeformMeshAsset;
+class UDeformMeshAnimation;
+class FDeformMeshSectionRenderData;
+class FDeformMeshFrozenRenderData;
+class UDeformMeshFieldSubsystem;
 
+/**
+ * One deform transform update of one section
+ * This is also the record layout of the transform stream files (See DeformMeshTransformReplay.h), so it has to stay POD and 16 bytes aligned
+ */
+struct FDeformMeshTransformUpdate
+{
+	/** The section that we're updating */
+	int32 SectionIndex;
+	uint32 Padding[3];
+	/** The deform transform matrix, already transposed the same way it's stored in the section */
+	FMatrix DeformTransform;
+};
+static_assert(sizeof(FDeformMeshTransformUpdate) == 80, "FDeformMeshTransformUpdate is serialized as is, its size must not change");
 
 
-/** Mesh section of the DeformMesh. A mesh section is a part of the mesh that is rendered with one material (1 material per section)*/
+/** Where the per vertex deform weights of a section are read from, a weight of 0 pins the vertex and 1 deforms it fully */
+UENUM(BlueprintType)
+enum class EDeformMeshWeightSource : uint8
+{
+	/** Every vertex is fully deformed */
+	None,
+	/** The red channel of the static mesh's vertex colors */
+	VertexColor,
+	/** The U coordinate of one of the static mesh's texture coordinate channels, converted on the CPU when the scene proxy is created */
+	TexCoord
+};
+
+
+/** How the vertices of a section are deformed */
+UENUM(BlueprintType)
+enum class EDeformMeshDeformMode : uint8
+{
+	/** Blend towards the deform transform, by the distance to its origin */
+	Transform,
+	/** Bend the section along a spline, the same way a spline mesh component does */
+	Spline
+};
+
+
+/**
+ * Mesh section of the DeformMesh. A mesh section is a part of the mesh that is rendered with one material (1 material per section)
+ * The per frame data of a section (its deform transform and its bounds) isn't stored here, the component keeps it in dense arrays indexed like the sections
+ */
 USTRUCT()
 struct FDeformMeshSection
 {
@@ -26,29 +73,143 @@ public:
 	UPROPERTY()
 		UStaticMesh* StaticMesh;
 
-	/** The secondary transform matrix that we'll use to deform this mesh section*/
+	/** The deform mesh asset that this section was created from, if it wasn't created from a static mesh */
+	UPROPERTY()
+		UDeformMeshAsset* SourceAsset;
+
+	/** The section of SourceAsset that this section draws */
+	UPROPERTY()
+		int32 SourceAssetSectionIndex;
+
+	/** The GPU geometry of this section, when it comes from a deform mesh asset. It isn't saved, it's picked up from the asset again when the component is loaded */
+	TSharedPtr<FDeformMeshSectionRenderData, ESPMode::ThreadSafe> RenderData;
+
+	/** Points whose transformed box bounds the deformed section */
 	UPROPERTY()
-		FMatrix DeformTransform;
+		TArray<FVector> BoundsHullPoints;
 
-	/** Local bounding box of section */
+	/** Deprecated, the deform transform is in UDeformMeshComponent::SectionDeformTransforms now. Only loaded, so PostLoad() can move it there */
 	UPROPERTY()
-		FBox SectionLocalBox;
+		FMatrix DeformTransform_DEPRECATED;
+
+	/** Deprecated, the local box is in UDeformMeshComponent::SectionLocalBoxes now. Only loaded, so PostLoad() can move it there */
+	UPROPERTY()
+		FBox SectionLocalBox_DEPRECATED;
 
 	/** Should we display this section */
 	UPROPERTY()
 		bool bSectionVisible;
 
+	/** Should this section cast shadows, when the component casts shadows */
+	UPROPERTY()
+		bool bCastShadow;
+
+	/** Where the deform weights of this section are read from */
+	UPROPERTY()
+		EDeformMeshWeightSource DeformWeightSource;
+
+	/** The texture coordinate channel that the deform weights are read from, when they're read from one */
+	UPROPERTY()
+		int32 DeformWeightUVChannel;
+
+	/** The baked animation that this section plays instead of its deform transform, if any */
+	UPROPERTY()
+		UDeformMeshAnimation* Animation;
+
+	/** The world time at which the animation started */
+	UPROPERTY()
+		float AnimationStartTime;
+
+	/** Speed of the animation, 1 plays it at its frame rate */
+	UPROPERTY()
+		float AnimationPlayRate;
+
+	/** Does the animation loop, or hold its last frame */
+	UPROPERTY()
+		bool bLoopAnimation;
+
+	/** How the vertices of this section are deformed */
+	UPROPERTY()
+		EDeformMeshDeformMode DeformMode;
+
+	/** The spline that this section is bent along in spline mode, in component space */
+	UPROPERTY()
+		FSplineMeshParams SplineParams;
+
+	/** The axis of the mesh that is mapped along the spline */
+	UPROPERTY()
+		TEnumAsByte<ESplineMeshAxis::Type> SplineForwardAxis;
+
+	/** The up direction of the spline, used to orient the mesh around it */
+	UPROPERTY()
+		FVector SplineUpDir;
+
+	/** The value of the component's SectionsRevision when this section was created or replaced, so the deform field can tell it apart from the section that was there before */
+	uint32 Revision = 0;
+
+	/** The deformed positions that this section is drawn with while it's frozen, it isn't saved so loaded sections are live again */
+	TSharedPtr<FDeformMeshFrozenRenderData, ESPMode::ThreadSafe> FrozenData;
+
 	FDeformMeshSection()
-		: SectionLocalBox(ForceInit)
+		: StaticMesh(nullptr)
+		, SourceAsset(nullptr)
+		, SourceAssetSectionIndex(INDEX_NONE)
+		, DeformTransform_DEPRECATED(FMatrix::Identity)
+		, SectionLocalBox_DEPRECATED(ForceInit)
 		, bSectionVisible(true)
+		, bCastShadow(true)
+		, DeformWeightSource(EDeformMeshWeightSource::None)
+		, DeformWeightUVChannel(0)
+		, Animation(nullptr)
+		, AnimationStartTime(0.f)
+		, AnimationPlayRate(1.f)
+		, bLoopAnimation(true)
+		, DeformMode(EDeformMeshDeformMode::Transform)
+		, SplineForwardAxis(ESplineMeshAxis::X)
+		, SplineUpDir(FVector::UpVector)
 	{}
 
+	/** Returns the number of vertices of the geometry that this section renders */
+	int32 GetNumVertices() const;
+
+	/** Returns whether this section has something to render */
+	bool HasGeometry() const
+	{
+		return StaticMesh != nullptr || RenderData.IsValid();
+	}
+
+	/** Returns the box of the hull points transformed by a deform matrix (Not transposed) */
+	FBox CalcDeformedBox(const FMatrix& DeformMatrix) const
+	{
+		FBox Box(ForceInit);
+		for (const FVector& Point : BoundsHullPoints)
+		{
+			Box += DeformMatrix.TransformPosition(Point);
+		}
+		return Box;
+	}
+
 	/** Reset this section, clear all mesh info. */
 	void Reset()
 	{
 		StaticMesh = nullptr;
-		SectionLocalBox.Init();
+		SourceAsset = nullptr;
+		SourceAssetSectionIndex = INDEX_NONE;
+		RenderData.Reset();
+		BoundsHullPoints.Empty();
 		bSectionVisible = true;
+		bCastShadow = true;
+		DeformWeightSource = EDeformMeshWeightSource::None;
+		DeformWeightUVChannel = 0;
+		Animation = nullptr;
+		AnimationStartTime = 0.f;
+		AnimationPlayRate = 1.f;
+		bLoopAnimation = true;
+		DeformMode = EDeformMeshDeformMode::Transform;
+		SplineParams = FSplineMeshParams();
+		SplineForwardAxis = ESplineMeshAxis::X;
+		SplineUpDir = FVector::UpVector;
+		FrozenData.Reset();
 	}
 };
 
@@ -63,10 +224,64 @@ public:
 	
 	void CreateMeshSection(int32 SectionIndex, UStaticMesh* Mesh, const FTransform& DeformTransform);
 
+	/**
+	 *	Create a section from generated geometry, without building a static mesh. The arrays are moved into the section and read in place by its GPU buffers, they're never copied
+	 *	TexCoords is one channel of texture coordinates per vertex, it can be empty. The section doesn't have deform weights, and uses the material of its index
+	 *	Indices is a list of triangles, every index must be below the number of positions
+	 *	The geometry only lives on the GPU, it isn't saved with the component
+	 */
+	void CreateMeshSection(int32 SectionIndex, TArray<FVector>&& Positions, TArray<FVector2D>&& TexCoords, TArray<uint32>&& Indices, const FTransform& DeformTransform);
+
+	/**
+	 *	Rewrite a range of the positions of a section created from generated geometry, starting at FirstVertex. Only that range is uploaded, in place
+	 *	The number of vertices doesn't change, and the bounds of the section only grow to include the new positions
+	 */
+	void UpdateMeshSectionPositions(int32 SectionIndex, int32 FirstVertex, TArray<FVector>&& Positions);
+
+	/**
+	 *	Create one section per section of a cooked deform mesh asset, starting at FirstSectionIndex.
+	 *	The sections use the GPU buffers of the asset directly, and start with its default deform transforms, visibility and materials.
+	 */
+	void CreateMeshSectionsFromAsset(UDeformMeshAsset* Asset, int32 FirstSectionIndex = 0);
+
+	/**
+	 *	Pick up the current render data and hull points of the sections created from a deform mesh asset, the asset calls this on every component when it's rebuilt
+	 *	If anything changed, the scene proxy is recreated right away, so the previous render data is released
+	 */
+	void RefreshSectionsFromAsset(const UDeformMeshAsset* Asset);
+
+	/**
+	 *	Create a section from a mesh that doesn't need to be loaded yet.
+	 *	The mesh is streamed in in the background, and the section is created when it arrives, sections closer to the views are loaded first.
+	 *	Transform updates of the section while it's loading are kept and used when the section is created.
+	 */
+	void CreateMeshSectionAsync(int32 SectionIndex, const TSoftObjectPtr<UStaticMesh>& Mesh, const FTransform& DeformTransform);
+
+	/** Returns whether the mesh of a section is still being streamed in */
+	bool IsMeshSectionLoading(int32 SectionIndex) const;
+
 	void UpdateMeshSectionTransform(int32 SectionIndex, const FTransform& DeformTransform);
 
 	void FinishTransformsUpdate();
 
+	/** Update the deform transforms of several sections at once, this enqueues only one render command for all of them */
+	void UpdateMeshSectionTransforms(const FDeformMeshTransformUpdate* Updates, int32 NumUpdates);
+
+	/**
+	 *	Same as UpdateMeshSectionTransforms(), but the render thread reads the updates where they are instead of a copy, unless some of them are skipped
+	 *	The updates must stay valid until the rendering commands are flushed (For example the mapped frames of a FDeformMeshTransformReplay)
+	 */
+	void UpdateMeshSectionTransformsInPlace(const FDeformMeshTransformUpdate* Updates, int32 NumUpdates);
+
+	/** Start appending all the transform updates to a binary file, every FinishTransformsUpdate() call writes one frame */
+	bool StartRecordingTransforms(const FString& Filename);
+
+	/** Stop recording and close the file, the updates made since the last FinishTransformsUpdate() are written as a last frame */
+	void StopRecordingTransforms();
+
+	/** Returns whether the transform updates are currently being recorded */
+	bool IsRecordingTransforms() const { return TransformsRecorder.IsValid(); }
+
 	/** Clear a section of the DeformMesh. Other sections do not change index. */
 	void ClearMeshSection(int32 SectionIndex);
 
@@ -79,6 +294,85 @@ public:
 	/** Returns whether a particular section is currently visible */
 	bool IsMeshSectionVisible(int32 SectionIndex) const;
 
+	/**
+	 *	Control the visibility of many sections at once, bit N is the visibility of section N. Sections past the end of the array keep their visibility
+	 *	This costs one render command whatever the number of sections, use it to show or hide thousands of sections in one frame
+	 */
+	void SetMeshSectionsVisibility(const TBitArray<>& Visibility);
+
+	/** Control whether a particular section casts shadows, this doesn't recreate the scene proxy */
+	void SetMeshSectionCastShadow(int32 SectionIndex, bool bNewCastShadow);
+
+	/** Returns whether a particular section casts shadows */
+	bool IsMeshSectionCastingShadow(int32 SectionIndex) const;
+
+	/**
+	 *	Choose where the per vertex deform weights of a static mesh section are read from, this recreates the scene proxy
+	 *	Meshes that don't have the channel are fully deformed. The texture coordinates are read on the CPU, so cooked meshes need to allow CPU access
+	 *	Sections created from a deform mesh asset don't have weights
+	 */
+	void SetMeshSectionDeformWeights(int32 SectionIndex, EDeformMeshWeightSource Source, int32 UVChannel = 0);
+
+	/** Returns where the deform weights of a section are read from */
+	EDeformMeshWeightSource GetMeshSectionDeformWeightSource(int32 SectionIndex) const;
+
+	/**
+	 *	Play a baked deform animation on a section, the section stops using its deform transform until the animation is stopped
+	 *	Nothing is sent to the render thread while it plays, the frames are picked on the GPU from the world time
+	 *	The animation must have been baked from a mesh with the same vertices as the section
+	 */
+	void PlayMeshSectionAnimation(int32 SectionIndex, UDeformMeshAnimation* Animation, float PlayRate = 1.f, bool bLoop = true);
+
+	/** Stop the baked animation of a section, it goes back to its deform transform */
+	void StopMeshSectionAnimation(int32 SectionIndex);
+
+	/** Returns whether a section is playing a baked animation */
+	bool IsMeshSectionPlayingAnimation(int32 SectionIndex) const;
+
+	/**
+	 *	Bend a section along a spline and switch it to the spline deform mode, this doesn't recreate the scene proxy
+	 *	The extent of the section's mesh along the forward axis is mapped to the whole spline, the deform weights still apply
+	 */
+	void SetMeshSectionSplineDeform(int32 SectionIndex, const FSplineMeshParams& SplineParams, ESplineMeshAxis::Type ForwardAxis = ESplineMeshAxis::X, const FVector& UpDir = FVector::UpVector);
+
+	/** Switch a section between its deform transform and its spline, this doesn't recreate the scene proxy */
+	void SetMeshSectionDeformMode(int32 SectionIndex, EDeformMeshDeformMode DeformMode);
+
+	/** Returns how the vertices of a section are deformed */
+	EDeformMeshDeformMode GetMeshSectionDeformMode(int32 SectionIndex) const;
+
+	/**
+	 *	Bake the current deformation of a section into its own vertex buffer, and draw it like a static mesh without any deform shader work, in every pass
+	 *	The positions are deformed on a task graph worker, the section keeps being deformed live until they're ready. This recreates the scene proxy when they are
+	 *	The deformation is baked with the current transform of the component, the deform transform and spline changes of a frozen section are kept but not drawn until it's unfrozen
+	 *	Only static mesh sections whose mesh allows CPU access and that don't play an animation can be frozen, playing an animation unfreezes a section
+	 *	Only the positions are baked, the normals keep their rest direction, so the shading of a lit material can change when a bent section is frozen
+	 */
+	bool FreezeMeshSection(int32 SectionIndex);
+
+	/** Go back to deforming a frozen section live, with its latest deform transform or spline. This recreates the scene proxy */
+	void UnfreezeMeshSection(int32 SectionIndex);
+
+	/** Returns whether a section is frozen, or being frozen */
+	bool IsMeshSectionFrozen(int32 SectionIndex) const;
+
+	/** Set the number of LODs that are skipped when drawing the shadows of static mesh sections, 0 draws the shadows with the same LOD as the section */
+	void SetShadowLODBias(int32 NewShadowLODBias);
+
+	/**
+	 *	Number of LODs that are skipped when drawing the shadows of static mesh sections, this makes the shadow depth passes cheaper with many deform meshes
+	 *	Only static mesh sections whose mesh has that many LODs are affected, sections created from a deform mesh asset always use their own geometry
+	 */
+	UPROPERTY(EditAnywhere, Category = "Lighting", meta = (ClampMin = 0))
+		int32 ShadowLODBias;
+
+	/** Choose whether the deformers of the world's deform field (See UDeformMeshFieldSubsystem) deform the sections of this component */
+	void SetAffectedByDeformField(bool bNewAffectedByDeformField);
+
+	/** Are the sections of this component deformed by the deformers of the world's deform field, they then own the deform transforms of the sections within their radius */
+	UPROPERTY(EditAnywhere, Category = "Deform Field")
+		bool bAffectedByDeformField;
+
 	/** Returns number of sections currently created for this component */
 	int32 GetNumSections() const;
 
@@ -88,9 +382,12 @@ public:
 	 */
 	FDeformMeshSection* GetDeformMeshSection(int32 SectionIndex);
 
-	/** Replace a section with new section geometry */
+	/** Replace a section with new section geometry, it keeps its deform transform */
 	void SetDeformMeshSection(int32 SectionIndex, const FDeformMeshSection& Section);
 
+	/** Returns the deform transform matrix of a section (Not transposed) */
+	FMatrix GetMeshSectionDeformMatrix(int32 SectionIndex) const;
+
 
 	
 	//~ Begin UPrimitiveComponent Interface.
@@ -113,6 +410,19 @@ public:
 	//~ End UMeshComponent Interface.
 
 
+	//~ Begin UActorComponent Interface.
+	virtual void OnComponentDestroyed(bool bDestroyingHierarchy) override;
+	virtual void OnRegister() override;
+	virtual void OnUnregister() override;
+	//~ End UActorComponent Interface.
+
+
+	//~ Begin UObject Interface.
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void PostLoad() override;
+	//~ End UObject Interface.
+
+
 private:
 
 	//~ Begin USceneComponent Interface.
@@ -123,21 +433,90 @@ private:
 	* But we need to manage the bounds of our component by implementing this method
 	*/
 	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+	/* The deform field rebuilds the entries of the component when it moves */
+	virtual void OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport = ETeleportType::None) override;
 	//~ Begin USceneComponent Interface.
 
 
 	/** Update LocalBounds member from the local box of each section */
 	void UpdateLocalBounds();
 
+	/** Resize the sections and their parallel arrays, new sections are empty with an identity deform transform */
+	void SetNumSections(int32 NumSections);
+
+	/** Clear the mesh info of a section and its bounds, it keeps its deform transform */
+	void ResetSection(int32 SectionIndex);
+
+	/** Increment SectionsRevision, and let the deform field know that the sections changed */
+	void MarkSectionsChanged();
+
+	/** Returns the deform field that the component is registered to, or null if it isn't affected by the field */
+	UDeformMeshFieldSubsystem* GetDeformField() const;
+
+	/** Called by the streamable manager when the mesh of a streamed section is loaded */
+	void OnSectionMeshLoaded(int32 SectionIndex);
+
+	/** Cancel the streaming of a section's mesh, if it's being streamed */
+	void CancelSectionLoad(int32 SectionIndex);
+
+	/** Send the deform mode and the spline of a section to the scene proxy and update its bounds */
+	void UpdateMeshSectionSpline(int32 SectionIndex);
+
+	/** Write the recorded updates of the current frame to the recorder */
+	void WriteRecordedFrame();
+
+	/** Shared by UpdateMeshSectionTransforms() and UpdateMeshSectionTransformsInPlace(), the render command only copies the updates when they may not outlive it */
+	void UpdateMeshSectionTransforms_Internal(const FDeformMeshTransformUpdate* Updates, int32 NumUpdates, bool bUpdatesOutliveRenderCommands);
+
+	/** Point the sections created from a deform mesh asset (Only from this asset, if one is given) to its current render data, returns whether any of them changed */
+	bool AcquireAssetRenderData(const UDeformMeshAsset* Asset = nullptr);
+
+	/** Async load priority of a section whose deform transform is at this location, the closer to a view the higher */
+	int32 GetSectionLoadPriority(const FVector& DeformLocation) const;
+
 	/** Array of sections of mesh */
 	UPROPERTY()
 		TArray<FDeformMeshSection> DeformMeshSections;
 
+	/** The deform transform matrix of each section (transposed), parallel to DeformMeshSections so the scene proxy copies it as is */
+	UPROPERTY()
+		TArray<FMatrix> SectionDeformTransforms;
+
+	/** Local bounding box of each section, parallel to DeformMeshSections */
+	UPROPERTY()
+		TArray<FBox> SectionLocalBoxes;
+
 	/** Local space bounds of mesh */
 	UPROPERTY()
 		FBoxSphereBounds LocalBounds;
 
+	/** The file that the transform updates are recorded to, if we're recording */
+	TUniquePtr<FArchive> TransformsRecorder;
+
+	/** The transform updates of the current frame, written to the recorder on FinishTransformsUpdate() */
+	TArray<FDeformMeshTransformUpdate> RecordedUpdates;
+
+	/** Number of frames written to the recorder */
+	uint32 NumRecordedFrames;
+
+	/** A section that will be created when its mesh is streamed in */
+	struct FPendingSectionLoad
+	{
+		TSharedPtr<FStreamableHandle> Handle;
+		/** The mesh that is being loaded */
+		TSoftObjectPtr<UStaticMesh> Mesh;
+		/** The latest deform transform of the section */
+		FTransform DeformTransform;
+	};
+
+	/** Sections whose mesh is being streamed in, by section index */
+	TMap<int32, FPendingSectionLoad> PendingSectionLoads;
+
+	/** Incremented whenever sections are created, cleared or replaced, so the deform field knows when to rebuild its entries */
+	uint32 SectionsRevision;
+
 	friend class FDeformMeshSceneProxy;
+	friend class UDeformMeshFieldSubsystem;
 };
 
 
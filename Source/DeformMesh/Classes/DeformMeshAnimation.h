@@ -0,0 +1,125 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectMacros.h"
+#include "Engine/DataAsset.h"
+#include "Engine/EngineTypes.h"
+#include "RenderCommandFence.h"
+#include "Components/DeformMeshComponent.h"
+#include "DeformMeshAnimation.generated.h"
+
+//Forward declarations
+class UStaticMesh;
+class FDeformMeshAnimationRenderData;
+
+/**
+ *	A deformation baked into per vertex offsets, for canned deform motions that repeat
+ *	The baker runs the CPU version of the deform math (See FDeformMeshMath) on every vertex of a mesh, for every frame of a recorded transform stream
+ *	A section playing it with UDeformMeshComponent::PlayMeshSectionAnimation() doesn't need any transform update, the shader picks the frames from the world time
+ *	The offsets are in the local space of the component that the stream was recorded on, so the animation has to be played on a component with the same transform
+ */
+UCLASS(BlueprintType)
+class DEFORMMESH_API UDeformMeshAnimation : public UDataAsset
+{
+	GENERATED_BODY()
+public:
+
+	UDeformMeshAnimation();
+
+#if WITH_EDITORONLY_DATA
+	/** The mesh of the section that is baked, only its first LOD is used. Sections of a deform mesh asset built from this mesh have the same vertices */
+	UPROPERTY(EditAnywhere, Category = "Source")
+		UStaticMesh* SourceMesh;
+
+	/** The transform stream recorded with DeformMesh.RecordTransforms or UDeformMeshComponent::StartRecordingTransforms() */
+	UPROPERTY(EditAnywhere, Category = "Source", meta = (FilePathFilter = "dmtransforms"))
+		FFilePath TransformStream;
+
+	/** The section of the recorded component whose transforms are baked */
+	UPROPERTY(EditAnywhere, Category = "Source", meta = (ClampMin = 0))
+		int32 SourceSectionIndex;
+
+	/** The deform transform of the section until its first update in the stream */
+	UPROPERTY(EditAnywhere, Category = "Source")
+		FTransform InitialDeformTransform;
+
+	/** The transform of the recorded component */
+	UPROPERTY(EditAnywhere, Category = "Source")
+		FTransform ComponentTransform;
+
+	/** Where the deform weights of the recorded section were read from, they're baked in the offsets */
+	UPROPERTY(EditAnywhere, Category = "Source")
+		EDeformMeshWeightSource WeightSource;
+
+	/** The texture coordinate channel that the deform weights were read from, when they were read from one */
+	UPROPERTY(EditAnywhere, Category = "Source", meta = (ClampMin = 0))
+		int32 WeightUVChannel;
+#endif
+
+	/** Number of frames per second of playback, the stream records one frame per FinishTransformsUpdate() call */
+	UPROPERTY(EditAnywhere, Category = "Playback", meta = (ClampMin = 1))
+		float FrameRate;
+
+#if WITH_EDITOR
+	/** Bake the source stream into offsets, and recreate the render data */
+	UFUNCTION(CallInEditor, Category = "Source")
+		void Bake();
+
+	/**
+	 *	Bake a deform transform track into offsets
+	 *	@param Mesh				The mesh whose first LOD is deformed
+	 *	@param LocalToWorld		The transform of the component
+	 *	@param DeformTrack		One deform transform matrix per frame, already transposed the same way it's stored in the section
+	 *	@param InWeightSource	Where the deform weights of the mesh are read from
+	 *	@param InWeightUVChannel	The texture coordinate channel that the deform weights are read from, when they're read from one
+	 */
+	bool BakeTrack(UStaticMesh* Mesh, const FTransform& LocalToWorld, const TArray<FMatrix>& DeformTrack, EDeformMeshWeightSource InWeightSource = EDeformMeshWeightSource::None, int32 InWeightUVChannel = 0);
+#endif
+
+	/** Returns the number of vertices of the baked mesh */
+	int32 GetNumVertices() const { return NumVertices; }
+
+	/** Returns the number of baked frames */
+	int32 GetNumFrames() const { return FrameScales.Num(); }
+
+	/** Returns the local bounds of the baked mesh over all the frames */
+	const FBox& GetBounds() const { return Bounds; }
+
+	/** Returns the GPU data of the animation, shared by every section that plays it. Invalid if nothing was baked */
+	TSharedPtr<FDeformMeshAnimationRenderData, ESPMode::ThreadSafe> GetRenderData() const { return RenderData; }
+
+	//~ Begin UObject Interface.
+	virtual void PostLoad() override;
+	virtual void BeginDestroy() override;
+	virtual bool IsReadyForFinishDestroy() override;
+	//~ End UObject Interface.
+
+private:
+
+	/** Create the render data from the baked offsets */
+	void InitResources();
+
+	/** Number of vertices of the baked mesh */
+	UPROPERTY()
+		int32 NumVertices;
+
+	/** 4 int16 per vertex per frame, the offsets of a frame divided by its scale */
+	UPROPERTY()
+		TArray<int16> QuantizedOffsets;
+
+	/** The largest offset component of each frame, what a quantized value of 32767 stands for */
+	UPROPERTY()
+		TArray<float> FrameScales;
+
+	/** The local bounds of the baked mesh over all the frames */
+	UPROPERTY()
+		FBox Bounds;
+
+	/** The GPU data, it's created from the arrays above without copying them */
+	TSharedPtr<FDeformMeshAnimationRenderData, ESPMode::ThreadSafe> RenderData;
+
+	/** Used to know when the buffers were created, so the arrays can be freed */
+	FRenderCommandFence ReleaseFence;
+};
@@ -0,0 +1,171 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectMacros.h"
+#include "Engine/DataAsset.h"
+#include "Serialization/BulkData.h"
+#include "RenderCommandFence.h"
+#include "DeformMeshAsset.generated.h"
+
+//Forward declarations
+class UStaticMesh;
+class UMaterialInterface;
+class FDeformMeshSectionRenderData;
+class UDeformMeshComponent;
+
+///////////////////////////////////////////////////////////////////////
+// Deform mesh asset blob
+/*
+ * Everything a deform mesh asset needs at runtime is cooked in one bulk data blob:
+ * 1 One FDeformMeshAssetBlobHeader at the start of the blob
+ * 2 Then one FDeformMeshAssetBlobSection per section, this is the section table
+ * 3 Then the streams of every section, each one 16 bytes aligned: positions (FVector), texture coordinates (FVector2DHalf), indices (uint16 when possible, uint32 otherwise) and hull points (FVector)
+ * The streams are stored exactly the way the GPU buffers expect them, so they're uploaded straight from the memory mapped payload
+*/
+///////////////////////////////////////////////////////////////////////
+
+struct FDeformMeshAssetBlobHeader
+{
+	static constexpr uint32 ExpectedMagic = 0x4D464441; // 'ADFM'
+	/** 2: The hull points are the corners of the section's box */
+	static constexpr uint32 ExpectedVersion = 2;
+
+	uint32 Magic;
+	uint32 Version;
+	uint32 NumSections;
+	uint32 Padding;
+};
+static_assert(sizeof(FDeformMeshAssetBlobHeader) == 16, "Deform mesh asset blob records must stay 16 bytes aligned");
+
+struct FDeformMeshAssetBlobSection
+{
+	/** The default deform transform matrix, already transposed the same way it's stored in the section */
+	float DefaultDeformTransform[4][4];
+
+	uint32 NumVertices;
+	uint32 NumTexCoords;
+	uint32 NumIndices;
+	/** 2 or 4 bytes */
+	uint32 IndexStride;
+
+	/** Offsets of the streams, from the start of the blob */
+	uint32 PositionsOffset;
+	uint32 TexCoordsOffset;
+	uint32 IndicesOffset;
+	uint32 HullPointsOffset;
+
+	/** The 8 corners of the section's box, transforming them gives the bounds of the deformed section */
+	uint32 NumHullPoints;
+	uint32 bVisible;
+	uint32 Padding[2];
+};
+static_assert(sizeof(FDeformMeshAssetBlobSection) == 112, "Deform mesh asset blob records must stay 16 bytes aligned");
+
+
+/** A section of a deform mesh asset, as it's authored in the editor */
+USTRUCT()
+struct FDeformMeshAssetSourceSection
+{
+	GENERATED_BODY()
+public:
+
+	/** The static mesh that holds the mesh data for this section, only its first LOD is cooked */
+	UPROPERTY(EditAnywhere, Category = "Section")
+		UStaticMesh* StaticMesh = nullptr;
+
+	/** The deform transform that the section starts with */
+	UPROPERTY(EditAnywhere, Category = "Section")
+		FTransform DefaultDeformTransform;
+
+	/** Should the section be displayed when it's created */
+	UPROPERTY(EditAnywhere, Category = "Section")
+		bool bVisible = true;
+};
+
+
+/**
+ *	Cooked geometry for the sections of a deform mesh component
+ *	The sections are authored from static meshes in the editor, and cooked by Build() into one blob that is uploaded to the GPU without any transformation when the asset is loaded
+ *	Use UDeformMeshComponent::CreateMeshSectionsFromAsset() to create the sections of a component from it
+ */
+UCLASS(BlueprintType)
+class DEFORMMESH_API UDeformMeshAsset : public UDataAsset
+{
+	GENERATED_BODY()
+public:
+
+	UDeformMeshAsset();
+
+#if WITH_EDITORONLY_DATA
+	/** The sections that are cooked in this asset */
+	UPROPERTY(EditAnywhere, Category = "Source")
+		TArray<FDeformMeshAssetSourceSection> SourceSections;
+#endif
+
+	/** The material of each cooked section */
+	UPROPERTY(VisibleAnywhere, Category = "Cooked")
+		TArray<UMaterialInterface*> Materials;
+
+#if WITH_EDITOR
+	/** Cook the source sections into the blob, and recreate the render data */
+	UFUNCTION(CallInEditor, Category = "Source")
+		void Build();
+#endif
+
+	/** Returns number of cooked sections */
+	int32 GetNumSections() const { return SectionRenderData.Num(); }
+
+	/** Returns the GPU geometry of a section, shared by every component that uses it. Invalid if the section is empty */
+	TSharedPtr<FDeformMeshSectionRenderData, ESPMode::ThreadSafe> GetSectionRenderData(int32 SectionIndex) const;
+
+	/** Returns the default deform transform of a section, already transposed */
+	FMatrix GetSectionDefaultDeformTransform(int32 SectionIndex) const;
+
+	/** Returns whether a section is visible when it's created */
+	bool IsSectionVisibleByDefault(int32 SectionIndex) const;
+
+	/** Copy the hull points of a section */
+	void GetSectionHullPoints(int32 SectionIndex, TArray<FVector>& OutHullPoints) const;
+
+	/** Returns the material of a section */
+	UMaterialInterface* GetSectionMaterial(int32 SectionIndex) const;
+
+	//~ Begin UObject Interface.
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void PostLoad() override;
+	virtual void BeginDestroy() override;
+	virtual bool IsReadyForFinishDestroy() override;
+	virtual void FinishDestroy() override;
+	//~ End UObject Interface.
+
+private:
+
+	/** Lock the blob and create the render data of every section from it */
+	void InitResources();
+
+	/**
+	 *	Drop our references to the render data, make the components that use it drop theirs, and wait for it to be released before unlocking the blob
+	 *	Returns false, and keeps everything as it was, if something else still holds the render data, its buffers could read the blob again
+	 */
+	bool ReleaseResources(const TArray<UDeformMeshComponent*>& Users);
+
+	/** Unlock the blob, the render data must not read it anymore */
+	void UnlockBlob();
+
+	/** The cooked blob, memory mapped in cooked builds */
+	FByteBulkData BulkData;
+
+	/** The locked blob, valid while the render data is alive */
+	const uint8* LockedBlob;
+
+	/** The section table of the locked blob */
+	const FDeformMeshAssetBlobSection* BlobSections;
+
+	/** The render data of each section, null for empty sections */
+	TArray<TSharedPtr<FDeformMeshSectionRenderData, ESPMode::ThreadSafe>> SectionRenderData;
+
+	/** Used to know when the render data was released, so the blob can be unlocked */
+	FRenderCommandFence ReleaseFence;
+};
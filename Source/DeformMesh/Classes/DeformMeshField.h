@@ -0,0 +1,152 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectMacros.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "DeformMeshField.generated.h"
+
+class UDeformMeshComponent;
+struct FDeformMeshTransformUpdate;
+
+/** A deformer of the deform field, its transform is pushed to every deform mesh section within its radius */
+struct FDeformMeshFieldDeformer
+{
+	/** The deform transform of the sections that it affects, its origin is where the deformation happens */
+	FTransform Transform;
+	/** Sections whose box is within this distance of the origin are affected */
+	float Radius;
+	/** Whether it changed since the last tick, so the sections that it affects need its new transform */
+	bool bDirty;
+};
+
+/** A section in the spatial hash of the deform field */
+struct FDeformMeshFieldEntry
+{
+	UDeformMeshComponent* Component;
+	int32 SectionIndex;
+	/** The world box of the section without deformation */
+	FBox WorldBox;
+};
+
+/** A deform mesh component registered to the deform field */
+struct FDeformMeshFieldComponent
+{
+	/** The component transform and the sections revision that the entries were built with, the entries are rebuilt when one of them changes */
+	FTransform Transform;
+	uint32 SectionsRevision;
+	/** The cells that the sections of the component are in */
+	TSet<FIntVector> Cells;
+	/** Whether some sections of the component are too large for the hash, and are in the oversized entries */
+	bool bHasOversizedEntries = false;
+};
+
+/** A section that a deformer is currently pushing its transform to */
+struct FDeformMeshFieldSection
+{
+	/** The deform transform that the section had before, restored when no deformer affects it anymore */
+	FMatrix RestTransform;
+	/** The deformer that affects it, the closest one when there are several */
+	int32 DeformerId;
+	/** The revision of the section when it started being affected, a section replaced since then has its own transform and isn't restored */
+	uint32 SectionRevision;
+};
+
+/**
+ *	World wide deform field: deformers (A player, an explosion..) deform every deform mesh section within their radius, on all the deform mesh components of the world
+ *	The sections of the components that opted in (bAffectedByDeformField) are stored in a spatial hash of their undeformed world boxes
+ *	Every tick, each deformer only looks at the cells that it overlaps, and the affected sections get their transforms in one batched update per component
+ *	Sections far from every deformer are never visited, a component is only looked at again when it moves or its sections change, and the field doesn't tick at all when there are no deformers
+ *	A transform pushed to a section while it's affected becomes the transform that it gets back when it leaves the deformers, the deformer's transform is pushed again on the next tick
+ */
+UCLASS()
+class DEFORMMESH_API UDeformMeshFieldSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+public:
+
+	/** Returns the deform field of a world */
+	static UDeformMeshFieldSubsystem* Get(const UWorld* World);
+
+	/** Add a deformer to the field, returns its id */
+	int32 AddDeformer(const FTransform& Transform, float Radius);
+
+	/** Move a deformer or change its radius */
+	void UpdateDeformer(int32 DeformerId, const FTransform& Transform, float Radius);
+
+	/** Remove a deformer, the sections that it affected get their transforms back on the next tick */
+	void RemoveDeformer(int32 DeformerId);
+
+	/** Called by the deform mesh components that are affected by the field when they're registered and unregistered */
+	void RegisterComponent(UDeformMeshComponent* Component);
+	void UnregisterComponent(UDeformMeshComponent* Component);
+
+	/** Called by the registered components when they move or their sections change, their entries are rebuilt on the next tick */
+	void MarkComponentDirty(UDeformMeshComponent* Component);
+
+	/** Called by the registered components when a transform is pushed to one of their sections, an affected section keeps it as the transform that it gets back */
+	void OnSectionTransformUpdated(UDeformMeshComponent* Component, int32 SectionIndex, const FMatrix& DeformTransform);
+
+	//~ Begin USubsystem Interface.
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	//~ End USubsystem Interface.
+
+	//~ Begin FTickableGameObject Interface.
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	//~ End FTickableGameObject Interface.
+
+private:
+	/** Returns the cell of the spatial hash that contains a world position */
+	FIntVector GetCell(const FVector& Position) const;
+
+	/** Returns whether a box covers few enough cells to be walked cell by cell, see MaxCellSpan */
+	static bool IsCellSpanBounded(const FIntVector& MinCell, const FIntVector& MaxCell);
+
+	/** Sections and deformers that span more than this many cells on an axis aren't walked cell by cell, sections go to the oversized entries, and deformers test every entry */
+	static constexpr int32 MaxCellSpan = 8;
+
+	/** Rebuild the entries of a component in the spatial hash from its sections */
+	void RebuildComponentEntries(UDeformMeshComponent* Component, FDeformMeshFieldComponent& Record);
+
+	/** Remove the entries of a component from the spatial hash */
+	void RemoveComponentEntries(UDeformMeshComponent* Component, FDeformMeshFieldComponent& Record);
+
+	/** Stop affecting the sections of a component, their transforms are restored */
+	void ReleaseComponentSections(UDeformMeshComponent* Component);
+
+	/** Stop affecting the sections of a component that were cleared or replaced, without restoring them. The others stay affected, and are restored when they leave the deformers */
+	void ForgetReplacedSections(UDeformMeshComponent* Component);
+
+	/** Push transforms to the sections of a component, they aren't taken as new rest transforms */
+	void PushSectionTransforms(UDeformMeshComponent* Component, const TArray<FDeformMeshTransformUpdate>& Updates);
+
+	/** Size of the cells of the spatial hash, from the deform mesh settings */
+	float CellSize;
+
+	/** The deformers, their index is their id */
+	TSparseArray<FDeformMeshFieldDeformer> Deformers;
+
+	/** The spatial hash, the sections of all the registered components by the cells that their world boxes overlap */
+	TMultiMap<FIntVector, FDeformMeshFieldEntry> Entries;
+
+	/** The sections whose world box is too large for the hash, every deformer tests them */
+	TArray<FDeformMeshFieldEntry> OversizedEntries;
+
+	/** The registered components, they unregister themselves before they're destroyed */
+	TMap<UDeformMeshComponent*, FDeformMeshFieldComponent> Components;
+
+	/** The registered components that moved or whose sections changed since the last tick */
+	TSet<UDeformMeshComponent*> DirtyComponents;
+
+	/** Set while the field pushes its own transforms, so they aren't taken as rest transforms */
+	bool bPushingTransforms = false;
+
+	/** The sections that are currently affected by a deformer, by component and section index */
+	TMap<TPair<UDeformMeshComponent*, int32>, FDeformMeshFieldSection> AffectedSections;
+};
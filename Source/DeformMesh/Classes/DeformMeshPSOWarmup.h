@@ -0,0 +1,46 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Engine/World.h"
+#include "DeformMeshPSOWarmup.generated.h"
+
+class UDeformMeshComponent;
+
+/**
+ *	Draws every material allowed in the deform mesh settings on a tiny deform mesh in front of the camera for a few frames, and then destroys itself
+ *	This creates the pipeline states of the deform mesh during loading, instead of the first frame a deform mesh is shown
+ *	It's also how the PSO precache list is generated: run the game with -logPSO, run DeformMesh.WarmupPSOs, and expand the recorded pipeline cache with the ShaderPipelineCacheTools commandlet
+ */
+UCLASS(NotPlaceable, Transient)
+class DEFORMMESH_API ADeformMeshPSOWarmup : public AActor
+{
+	GENERATED_BODY()
+public:
+
+	ADeformMeshPSOWarmup();
+
+	/** Spawn a warm up actor in this world, NumFrames overrides the frame count of the settings when it's positive */
+	static ADeformMeshPSOWarmup* StartWarmup(UWorld* World, int32 NumFrames = 0);
+
+	/** Starts the warm up in game worlds if the settings ask for it */
+	static void OnWorldInitializedActors(const UWorld::FActorsInitializedParams& Params);
+
+protected:
+	virtual void BeginPlay() override;
+
+public:
+	virtual void Tick(float DeltaTime) override;
+
+private:
+	/** Put the component right in front of the camera, so it passes the frustum and occlusion culling */
+	void FollowCamera();
+
+	UPROPERTY()
+		UDeformMeshComponent* DeformMeshComponent;
+
+	/** Frames left before we destroy ourselves */
+	int32 RemainingFrames;
+};
@@ -0,0 +1,72 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectMacros.h"
+#include "UObject/SoftObjectPtr.h"
+#include "Engine/DeveloperSettings.h"
+#include "DeformMeshSettings.generated.h"
+
+class UMaterialInterface;
+
+/**
+ *	Project settings of the deform mesh, they control which shader permutations are compiled for the deform mesh vertex factory, and which materials are warmed up
+ *	They're found in Project Settings > Engine > Deform Mesh, and saved in DefaultGame.ini
+ *	The shader permutation settings are not part of the key of the material shader maps in the DDC, a shader map cached with the previous settings would still be used
+ *	So after changing them, the deform mesh shaders need to be rebuilt: touch LocalVertexFactory.ush of the plugin, or clear the DDC, before cooking
+ */
+UCLASS(config = Game, defaultconfig, meta = (DisplayName = "Deform Mesh"))
+class DEFORMMESH_API UDeformMeshSettings : public UDeveloperSettings
+{
+	GENERATED_BODY()
+public:
+
+	UDeformMeshSettings();
+
+	/** Materials that can be used on deform mesh sections, material instances are allowed when one of their parents is listed. When the list is not empty, sections with any other material are rendered with the default material */
+	UPROPERTY(config, EditAnywhere, Category = "Materials")
+		TArray<TSoftObjectPtr<UMaterialInterface>> AllowedMaterials;
+
+	/** Compile the deform mesh shaders for masked unlit materials, the shaders need to be rebuilt when this is changed (See above) */
+	UPROPERTY(config, EditAnywhere, Category = "Shader Permutations", meta = (ConfigRestartRequired = true))
+		bool bCompileForMaskedMaterials;
+
+	/** Compile the deform mesh shaders for translucent unlit materials, the shaders need to be rebuilt when this is changed (See above) */
+	UPROPERTY(config, EditAnywhere, Category = "Shader Permutations", meta = (ConfigRestartRequired = true))
+		bool bCompileForTranslucentMaterials;
+
+	/** Draw every allowed material on a deform mesh when a game world begins play, so their pipeline states are created before the first real deform mesh is shown */
+	UPROPERTY(config, EditAnywhere, Category = "PSO Precaching")
+		bool bWarmupPSOsOnBeginPlay;
+
+	/** Number of frames that the allowed materials are drawn for when warming up */
+	UPROPERTY(config, EditAnywhere, Category = "PSO Precaching", meta = (ClampMin = 1))
+		int32 WarmupFrames;
+
+	/** Size of the cells of the deform field's spatial hash, about the radius of a typical deformer. It's read when a world is created */
+	UPROPERTY(config, EditAnywhere, Category = "Deform Field", meta = (ClampMin = 1))
+		float DeformFieldCellSize;
+
+	/** Returns whether a material can be rendered on a deform mesh section */
+	bool IsMaterialAllowed(const UMaterialInterface* Material) const;
+
+	//~ Begin UDeveloperSettings Interface.
+	virtual FName GetCategoryName() const override { return TEXT("Engine"); }
+	//~ End UDeveloperSettings Interface.
+
+	//~ Begin UObject Interface.
+	virtual void PostInitProperties() override;
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+	//~ End UObject Interface.
+
+private:
+
+	/** Rebuild the set of allowed material paths from the list */
+	void CacheAllowedMaterials();
+
+	/** The paths of the allowed materials, for fast lookups when scene proxies are created */
+	TSet<FSoftObjectPath> AllowedMaterialPaths;
+};
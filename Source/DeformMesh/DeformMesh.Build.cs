@@ -16,6 +16,7 @@ public class DeformMesh : ModuleRules
 		{
 			"Core",
 			"CoreUObject",
+			"DeveloperSettings",
 			"Engine",
 			"InteractiveToolsFramework",
 			"MeshDescription",
@@ -4,6 +4,32 @@
 #include "Modules/ModuleManager.h"
 #include "Misc/Paths.h"
 #include "GlobalShader.h"
+#include "DeformMeshStats.h"
+#include "DeformMeshPSOWarmup.h"
+#include "DeformMeshCustomVersion.h"
+#include "Serialization/CustomVersion.h"
+
+DEFINE_STAT(STAT_DeformMesh_UpdateSectionTransform);
+DEFINE_STAT(STAT_DeformMesh_FinishTransformsUpdate);
+DEFINE_STAT(STAT_DeformMesh_UploadTransforms);
+DEFINE_STAT(STAT_DeformMesh_CreateSceneProxy);
+DEFINE_STAT(STAT_DeformMesh_GetDynamicMeshElements);
+DEFINE_STAT(STAT_DeformMesh_GenerateSectionBatches);
+DEFINE_STAT(STAT_DeformMesh_UpdateDeformField);
+DEFINE_STAT(STAT_DeformMesh_FreezeSection);
+
+DEFINE_STAT(STAT_DeformMesh_Sections);
+DEFINE_STAT(STAT_DeformMesh_Draws);
+DEFINE_STAT(STAT_DeformMesh_TransformBytesUploaded);
+DEFINE_STAT(STAT_DeformMesh_RenderCommands);
+DEFINE_STAT(STAT_DeformMesh_ProxyRebuilds);
+
+CSV_DEFINE_CATEGORY(DeformMesh, true);
+
+const FGuid FDeformMeshCustomVersion::GUID(0xF90CB648, 0xBECA42F5, 0xB6CDFF15, 0x682622C4);
+
+// Register the custom version with core
+FCustomVersionRegistration GRegisterDeformMeshCustomVersion(FDeformMeshCustomVersion::GUID, FDeformMeshCustomVersion::LatestVersion, TEXT("DeformMeshVer"));
 
 IMPLEMENT_GAME_MODULE( FDeformMeshModule, DeformMesh);
 
@@ -13,9 +39,13 @@ void FDeformMeshModule::StartupModule()
 	// Maps virtual shader source directory to actual shaders directory on disk.
 	FString ShaderDirectory = FPaths::Combine(FPaths::ProjectDir(), TEXT("Shaders/Private"));
 	AddShaderSourceDirectoryMapping("/CustomShaders", ShaderDirectory);
+
+	// Warm up the deform mesh pipeline states when game worlds start, if the project settings ask for it
+	WorldInitializedActorsHandle = FWorldDelegates::OnWorldInitializedActors.AddStatic(&ADeformMeshPSOWarmup::OnWorldInitializedActors);
 }
 
 void FDeformMeshModule::ShutdownModule()
 {
+	FWorldDelegates::OnWorldInitializedActors.Remove(WorldInitializedActorsHandle);
 }
 
@@ -25,4 +25,7 @@ public:
 public:
 	virtual void StartupModule() override;
 	virtual void ShutdownModule() override;
+
+private:
+	FDelegateHandle WorldInitializedActorsHandle;
 };
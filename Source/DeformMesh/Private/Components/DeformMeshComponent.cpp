@@ -16,10 +16,51 @@
 #include "MeshMaterialShader.h"
 #include "ShaderParameters.h"
 #include "RHIUtilities.h"
+#include "DeformMeshStats.h"
+#include "DeformMeshTransformReplay.h"
+#include "DeformMeshAsset.h"
+#include "DeformMeshRenderData.h"
+#include "DeformMeshTransformPool.h"
+#include "DeformMeshSettings.h"
+#include "DeformMeshAnimation.h"
+#include "DeformMeshMath.h"
+#include "DeformMeshField.h"
+#include "DeformMeshCustomVersion.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Async/ParallelFor.h"
+#include "Misc/App.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
 
 #include "MeshMaterialShader.h"
 
 
+DEFINE_LOG_CATEGORY_STATIC(LogDeformMeshComponent, Log, All);
+
+static TAutoConsoleVariable<int32> CVarDeformMeshMaxSectionInitsPerFrame(
+	TEXT("r.DeformMesh.MaxSectionInitsPerFrame"),
+	32,
+	TEXT("Maximum number of deform mesh sections whose render resources are initialized per frame, for all the deform mesh components. 0 means no limit.\n")
+	TEXT("Sections over the budget are not rendered until a later frame, so creating big components is spread over several frames."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<int32> CVarDeformMeshParallelBatchMinSections(
+	TEXT("r.DeformMesh.ParallelBatchMinSections"),
+	256,
+	TEXT("Minimum number of sections per task when the mesh batches of a deform mesh component are generated in parallel.\n")
+	TEXT("Components with less than twice this number of sections generate their batches on the render thread."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarDeformMeshStreamingDistancePerPriority(
+	TEXT("r.DeformMesh.StreamingDistancePerPriority"),
+	1000.f,
+	TEXT("Distance to the closest view that lowers the async load priority of a streamed deform mesh section by one."),
+	ECVF_Default);
 
 //Forward Declarations
 class FDeformMeshSceneProxy;
@@ -28,6 +69,18 @@ class FDeformMeshVertexFactoryShaderParameters;
 struct FDeformMeshVertexFactory;
 
 
+/* The baked animation that a section plays (See UDeformMeshAnimation), the frames are picked from the view's world time when the shader parameters are bound*/
+struct FDeformMeshSectionPlayback
+{
+	FDeformMeshAnimationRenderDataPtr RenderData;
+	float StartTime = 0.f;
+	float PlayRate = 1.f;
+	bool bLoop = true;
+
+	bool IsPlaying() const { return RenderData.IsValid(); }
+};
+
+
 ///////////////////////////////////////////////////////////////////////
 // The Deform Mesh Component Vertex Factory
 /*
@@ -42,11 +95,12 @@ struct FDeformMeshVertexFactory : FLocalVertexFactory
 public:
 
 
+	/* Manual vertex fetch is supported the same way as in the LocalVertexFactory: when the platform supports it, the streams are read from SRVs using the vertex id*/
+	/* So every deform mesh section ends up with the same position only vertex declaration, whatever its texture coordinates are*/
 	FDeformMeshVertexFactory(ERHIFeatureLevel::Type InFeatureLevel)
 		: FLocalVertexFactory(InFeatureLevel, "FDeformMeshVertexFactory")
+		, Playback(nullptr)
 	{
-		//We're not interested in Manual vertex fetch so we disable it 
-		bSupportsManualVertexFetch = false;
 	}
 
 	/* Should we cache the material's shadertype on this platform with this vertex factory? */
@@ -54,18 +108,33 @@ public:
 	/* For example, we're only intersted in unlit materials, so we only return true when 
 	1 Material Domain is Surface
 	2 Shading Model is Unlit
+	3 Blend Mode is enabled in the deform mesh settings (Opaque is always compiled, Masked and Translucent can be turned off)
 	* We also add the permutation for the default material, because if that's not found, the engine would crash
 	* That's because the default material is the fallback for all other materials, so it needs to be compiled for all vertex factories
 	*/
 	static bool ShouldCompilePermutation(const FVertexFactoryShaderPermutationParameters& Parameters)
 	{
-		if ((Parameters.MaterialParameters.MaterialDomain == MD_Surface &&
-			Parameters.MaterialParameters.ShadingModels == MSM_Unlit) ||
-			Parameters.MaterialParameters.bIsDefaultMaterial)
+		if (Parameters.MaterialParameters.bIsDefaultMaterial)
 		{
 			return true;
 		}
-		return false;
+
+		if (Parameters.MaterialParameters.MaterialDomain != MD_Surface ||
+			Parameters.MaterialParameters.ShadingModels != MSM_Unlit)
+		{
+			return false;
+		}
+
+		const UDeformMeshSettings* Settings = GetDefault<UDeformMeshSettings>();
+		if (Parameters.MaterialParameters.BlendMode == BLEND_Masked)
+		{
+			return Settings->bCompileForMaskedMaterials;
+		}
+		if (IsTranslucentBlendMode(Parameters.MaterialParameters.BlendMode))
+		{
+			return Settings->bCompileForTranslucentMaterials;
+		}
+		return true;
 	}
 
 	/* Modify compilation environment so we can control which parts of the shader file are taken in consideration by the shader compiler */
@@ -76,10 +145,15 @@ public:
 		const bool ContainsManualVertexFetch = OutEnvironment.GetDefinitions().Contains("MANUAL_VERTEX_FETCH");
 		if (!ContainsManualVertexFetch)
 		{
-			OutEnvironment.SetDefine(TEXT("MANUAL_VERTEX_FETCH"), TEXT("0"));
+			OutEnvironment.SetDefine(TEXT("MANUAL_VERTEX_FETCH"), RHISupportsManualVertexFetch(Parameters.Platform) ? TEXT("1") : TEXT("0"));
 		}
 
 		OutEnvironment.SetDefine(TEXT("DEFORM_MESH"), TEXT("1"));
+
+		//ShouldCompilePermutation() reads the settings, so they're part of the environment too, the shaders compiled with other settings are never picked from the shader job cache
+		//The material shader maps saved in the DDC aren't keyed on them though, see UDeformMeshSettings
+		const UDeformMeshSettings* Settings = GetDefault<UDeformMeshSettings>();
+		OutEnvironment.SetDefine(TEXT("DEFORM_MESH_PERMUTATIONS"), (Settings->bCompileForMaskedMaterials ? 1 : 0) | (Settings->bCompileForTranslucentMaterials ? 2 : 0));
 	}
 
 
@@ -105,11 +179,22 @@ public:
 			PosOnlyElements.Add(AccessStreamComponent(Data.PositionComponent, 0, EVertexInputStreamType::PositionOnly));
 		}
 
+		//With manual vertex fetch, the texcoords and the colors are read from their SRV, so they're not part of the declaration
+		const bool bUseManualVertexFetch = SupportsManualVertexFetch(GetFeatureLevel());
+
+		//The deform weights are in the color stream, the position only declaration needs them too so the depth passes deform the vertices the same way
+		//Sections without weights are bound to the null color buffer with a stride of 0, so every vertex reads white, which is a weight of 1
+		if (Data.ColorComponent.VertexBuffer != NULL && !bUseManualVertexFetch)
+		{
+			Elements.Add(AccessStreamComponent(Data.ColorComponent, 3));
+			PosOnlyElements.Add(AccessStreamComponent(Data.ColorComponent, 3, EVertexInputStreamType::PositionOnly));
+		}
+
 		//Initialize the Position Only vertex declaration which will be used in the depth pass
 		InitDeclaration(PosOnlyElements, EVertexInputStreamType::PositionOnly);
 
 		//We add all the available texcoords to the default element list, that's all what we'll need for unlit shading
-		if (Data.TextureCoordinates.Num())
+		if (Data.TextureCoordinates.Num() && !bUseManualVertexFetch)
 		{
 			const int32 BaseTexCoordAttribute = 4;
 			for (int32 CoordinateIndex = 0; CoordinateIndex < Data.TextureCoordinates.Num(); CoordinateIndex++)
@@ -133,6 +218,13 @@ public:
 
 		InitDeclaration(Elements);
 		check(IsValidRef(GetDeclaration()));
+
+		//The LocalVF uniform buffer holds the SRVs of the streams and the fetch parameters, it's only read by the shaders when manual vertex fetch is enabled
+		//Missing SRVs (For example the colors, or the tangents of an asset section) fall back to the null color buffer
+		if (bUseManualVertexFetch)
+		{
+			UniformBuffer = CreateLocalVFUniformBuffer(this, Data.LODLightmapDataIndex, nullptr, 0, 0);
+		}
 	}
 
 	/* No need to override the ReleaseRHI() method, since we're not crearting any additional resources*/
@@ -142,11 +234,14 @@ public:
 	//Setters
 	inline void SetTransformIndex(uint16 Index) { TransformIndex = Index; }
 	inline void SetSceneProxy(FDeformMeshSceneProxy* Proxy) { SceneProxy = Proxy; }
+	inline void SetPlayback(const FDeformMeshSectionPlayback* InPlayback) { Playback = InPlayback; }
 private:
 	//We need to pass this as a shader parameter, so we store it in the vertex factory and we use in the vertex factory shader parameters
 	uint16 TransformIndex;
 	//All the mesh sections proxies keep a pointer to the scene proxy of the component so they can access the unified SRV
 	FDeformMeshSceneProxy* SceneProxy;
+	//The baked animation of the section, only the vertex factory of the section's own geometry has one, since the offsets are per vertex
+	const FDeformMeshSectionPlayback* Playback;
 
 	friend class FDeformMeshVertexFactoryShaderParameters;
 };
@@ -161,7 +256,10 @@ private:
  * Stores the render thread data that it is needed to render one mesh section
  1 Vertex Data: Each mesh section creates an instance of the vertex factory(vertex streams and declarations), also each mesh section owns an index buffer
  2 Material : Contains a pointer to the material that will be used to render this section
- 3 Other Data: Visibility, and the maximum vertex index.
+ 3 Other Data: Shadow casting, and the maximum vertex index.
+ * The visibility of the sections is kept by the scene proxy in bit arrays, and the section proxies are allocated in one block, so the per frame loops don't chase pointers around the heap
+ * The indices are copied on a task graph worker, so the section is only rendered once that task is complete and its resources are initialized on the render thread
+ * Sections created from a deform mesh asset don't own an index buffer, they use the buffers of the shared render data of the asset instead
 */
 ///////////////////////////////////////////////////////////////////////
 class FDeformMeshSectionProxy
@@ -170,20 +268,95 @@ public:
 	////////////////////////////////////////////////////////
 	/* Material applied to this section */
 	UMaterialInterface* Material;
-	/* Index buffer for this section */
+	/* Index buffer for this section, when it's created from a static mesh */
 	FRawStaticIndexBuffer IndexBuffer;
+	/* The shared render data of this section, when it's created from a deform mesh asset */
+	FDeformMeshSectionRenderDataPtr RenderData;
+	/* The index buffer that we draw with, either ours or the one of the render data */
+	FIndexBuffer* DrawIndexBuffer;
+	/* Number of triangles to draw*/
+	uint32 NumPrimitives;
 	/* Vertex factory instance for this section */
 	FDeformMeshVertexFactory VertexFactory;
-	/* Whether this section is currently visible */
-	bool bSectionVisible;
+	/* Whether this section is drawn in the shadow depth passes */
+	bool bCastShadow;
 	/* Max vertix index is an info that is needed when rendering the mesh, so we cache it here so we don't have to pointer chase it later*/
 	uint32 MaxVertexIndex;
+	/* The static mesh vertex buffers that the vertex factory gets bound to when the section is finalized*/
+	FStaticMeshVertexBuffers* SourceVertexBuffers;
+	/* The task that fills the index buffer off the game thread*/
+	FGraphEventRef PrepareTask;
+	/* The baked animation that this section plays instead of its deform transform*/
+	FDeformMeshSectionPlayback Playback;
+	/* The color buffer that the deform weights are bound from, either the vertex colors of the static mesh or WeightBuffer. Null when the section doesn't have weights*/
+	FColorVertexBuffer* WeightSourceBuffer;
+	/* The deform weights converted from a texture coordinate channel by the prepare task*/
+	FColorVertexBuffer WeightBuffer;
+
+	/* Shadow LOD: when the component has a shadow LOD bias, the shadow depth passes draw a lower LOD of the static mesh*/
+	/* It has its own vertex factory and index buffer, bound to the streams of that LOD the same way as the main one: positions, texture coordinates (For masked materials), tangents and the deform weights*/
+	FDeformMeshVertexFactory ShadowVertexFactory;
+	FRawStaticIndexBuffer ShadowIndexBuffer;
+	FStaticMeshVertexBuffers* ShadowSourceVertexBuffers;
+	uint32 ShadowNumPrimitives;
+	uint32 ShadowMaxVertexIndex;
+	FColorVertexBuffer* ShadowWeightSourceBuffer;
+	FColorVertexBuffer ShadowWeightBuffer;
 
 	/* For each section, we'll create a vertex factory to store the per-instance mesh data*/
 	FDeformMeshSectionProxy(ERHIFeatureLevel::Type InFeatureLevel)
 		: Material(NULL)
+		, DrawIndexBuffer(nullptr)
+		, NumPrimitives(0)
 		, VertexFactory(InFeatureLevel)
-		, bSectionVisible(true)
+		, bCastShadow(true)
+		, MaxVertexIndex(0)
+		, SourceVertexBuffers(nullptr)
+		, WeightSourceBuffer(nullptr)
+		, ShadowVertexFactory(InFeatureLevel)
+		, ShadowSourceVertexBuffers(nullptr)
+		, ShadowNumPrimitives(0)
+		, ShadowMaxVertexIndex(0)
+		, ShadowWeightSourceBuffer(nullptr)
+	{}
+
+	/* Whether the shadow depth passes draw a lower LOD of this section*/
+	bool HasShadowLOD() const { return ShadowSourceVertexBuffers != nullptr; }
+};
+
+
+///////////////////////////////////////////////////////////////////////
+// The Frozen Section Proxy
+/*
+ * A frozen section isn't deformed anymore, it's drawn with a plain local vertex factory bound to its baked positions and to the same other streams as a deformed section
+ * Its mesh batch is static, so the renderer caches its draw commands when the proxy is added to the scene and nothing is done for it per frame
+*/
+///////////////////////////////////////////////////////////////////////
+class FDeformMeshFrozenSectionProxy
+{
+public:
+	/* Material applied to this section */
+	UMaterialInterface* Material;
+	/* The baked positions, shared with the game thread section */
+	FDeformMeshFrozenRenderDataPtr FrozenData;
+	/* Vertex factory without any deformation */
+	FLocalVertexFactory VertexFactory;
+	/* The static mesh vertex buffers that the other streams are bound from */
+	FStaticMeshVertexBuffers* SourceVertexBuffers;
+	/* The buffer bound as the color stream, either the vertex colors of the static mesh or the weights converted by the freeze task, null if the section doesn't have weights */
+	FColorVertexBuffer* WeightSourceBuffer;
+	/* The index buffer of the static mesh, it's drawn as is */
+	FRawStaticIndexBuffer* IndexBuffer;
+	/* Whether this section is drawn in the shadow depth passes */
+	bool bCastShadow;
+
+	FDeformMeshFrozenSectionProxy(ERHIFeatureLevel::Type InFeatureLevel)
+		: Material(NULL)
+		, VertexFactory(InFeatureLevel, "FDeformMeshFrozenSectionProxy")
+		, SourceVertexBuffers(nullptr)
+		, WeightSourceBuffer(nullptr)
+		, IndexBuffer(nullptr)
+		, bCastShadow(true)
 	{}
 };
 
@@ -206,27 +379,307 @@ static inline void InitOrUpdateResource(FRenderResource* Resource)
 /* 
  * Helper function that initializes the vertex buffers of the vertex factory's Data member from the static mesh vertex buffers
  * We're using this so we can initialize only the data that we're interested in.
+ * This is called on the render thread when a section is finalized
 */
-static void InitVertexFactoryData(FDeformMeshVertexFactory* VertexFactory, FStaticMeshVertexBuffers* VertexBuffers)
+static void InitVertexFactoryData_RenderThread(FDeformMeshVertexFactory* VertexFactory, FStaticMeshVertexBuffers* VertexBuffers, FColorVertexBuffer* WeightBuffer)
 {
-	ENQUEUE_RENDER_COMMAND(StaticMeshVertexBuffersLegacyInit)(
-		[VertexFactory, VertexBuffers](FRHICommandListImmediate& RHICmdList)
+	check(IsInRenderingThread());
+
+	//The static mesh normally initialized its vertex buffers already, and they're shared with every other user of the mesh, so we don't upload them again
+	if (!VertexBuffers->PositionVertexBuffer.IsInitialized())
+	{
+		VertexBuffers->PositionVertexBuffer.InitResource();
+	}
+	if (!VertexBuffers->StaticMeshVertexBuffer.IsInitialized())
+	{
+		VertexBuffers->StaticMeshVertexBuffer.InitResource();
+	}
+
+	//Use the RHI vertex buffers to create the needed Vertex stream components in an FDataType instance, and then set it as the data of the vertex factory
+	FLocalVertexFactory::FDataType Data;
+	VertexBuffers->PositionVertexBuffer.BindPositionVertexBuffer(VertexFactory, Data);
+	VertexBuffers->StaticMeshVertexBuffer.BindPackedTexCoordVertexBuffer(VertexFactory, Data);
+	//The tangents are not part of our vertex declaration, this only gives their SRV to the vertex factory for manual vertex fetch
+	VertexBuffers->StaticMeshVertexBuffer.BindTangentVertexBuffer(VertexFactory, Data);
+
+	//The deform weights are bound as the color stream, the null color buffer is bound when the section doesn't have weights
+	if (WeightBuffer)
+	{
+		if (!WeightBuffer->IsInitialized())
 		{
-			//Initialize or update the RHI vertex buffers
-			InitOrUpdateResource(&VertexBuffers->PositionVertexBuffer);
-			InitOrUpdateResource(&VertexBuffers->StaticMeshVertexBuffer);
+			WeightBuffer->InitResource();
+		}
+		WeightBuffer->BindColorVertexBuffer(VertexFactory, Data);
+	}
+	else
+	{
+		FColorVertexBuffer::BindDefaultColorVertexBuffer(VertexFactory, Data, FColorVertexBuffer::NullBindStride::ZeroForDefaultBufferBind);
+	}
+	VertexFactory->SetData(Data);
 
-			//Use the RHI vertex buffers to create the needed Vertex stream components in an FDataType instance, and then set it as the data of the vertex factory
-			FLocalVertexFactory::FDataType Data;
-			VertexBuffers->PositionVertexBuffer.BindPositionVertexBuffer(VertexFactory, Data);
-			VertexBuffers->StaticMeshVertexBuffer.BindPackedTexCoordVertexBuffer(VertexFactory, Data);
-			VertexFactory->SetData(Data);
+	//Initalize the vertex factory using the data that we just set, this will call the InitRHI() method that we implemented in out vertex factory
+	InitOrUpdateResource(VertexFactory);
+}
 
-			//Initalize the vertex factory using the data that we just set, this will call the InitRHI() method that we implemented in out vertex factory
-			InitOrUpdateResource(VertexFactory);
-		});
+/* Same as above, for a frozen section: the baked positions replace the ones of the static mesh*/
+/* The other streams are the ones of the deformed section, so the section looks the same once it's frozen*/
+static void InitVertexFactoryData_RenderThread(FDeformMeshFrozenSectionProxy& FrozenSection)
+{
+	check(IsInRenderingThread());
+
+	//The baked positions are shared by the proxies that draw the frozen section, so they're uploaded only once
+	FPositionVertexBuffer& PositionBuffer = FrozenSection.FrozenData->PositionBuffer;
+	if (!PositionBuffer.IsInitialized())
+	{
+		PositionBuffer.InitResource();
+	}
+
+	FStaticMeshVertexBuffers* VertexBuffers = FrozenSection.SourceVertexBuffers;
+	FLocalVertexFactory* VertexFactory = &FrozenSection.VertexFactory;
+	FLocalVertexFactory::FDataType Data;
+	PositionBuffer.BindPositionVertexBuffer(VertexFactory, Data);
+	VertexBuffers->StaticMeshVertexBuffer.BindPackedTexCoordVertexBuffer(VertexFactory, Data);
+	//Only the positions are baked, the normals keep their rest direction, so the lighting of a deformed lit material can pop when the section is frozen
+	VertexBuffers->StaticMeshVertexBuffer.BindTangentVertexBuffer(VertexFactory, Data);
+
+	//Like a deformed section, the material sees the deform weights as the vertex color, and there's no lightmap
+	if (FColorVertexBuffer* WeightBuffer = FrozenSection.WeightSourceBuffer)
+	{
+		if (!WeightBuffer->IsInitialized())
+		{
+			WeightBuffer->InitResource();
+		}
+		WeightBuffer->BindColorVertexBuffer(VertexFactory, Data);
+	}
+	else
+	{
+		FColorVertexBuffer::BindDefaultColorVertexBuffer(VertexFactory, Data, FColorVertexBuffer::NullBindStride::ZeroForDefaultBufferBind);
+	}
+	VertexFactory->SetData(Data);
+
+	InitOrUpdateResource(VertexFactory);
+}
+
+/* Same as above, for the buffers of a deform mesh asset section, which were already initialized when the asset was loaded*/
+static void InitVertexFactoryData_RenderThread(FDeformMeshVertexFactory* VertexFactory, const FDeformMeshSectionRenderData& RenderData)
+{
+	check(IsInRenderingThread());
+
+	FLocalVertexFactory::FDataType Data;
+	RenderData.BindVertexFactoryData(Data);
+	FColorVertexBuffer::BindDefaultColorVertexBuffer(VertexFactory, Data, FColorVertexBuffer::NullBindStride::ZeroForDefaultBufferBind);
+	VertexFactory->SetData(Data);
+
+	InitOrUpdateResource(VertexFactory);
+}
+
+/* Returns the buffer that the deform weights of a static mesh LOD are bound from, or null if the section doesn't use weights or the LOD doesn't have them*/
+/* The vertex colors are bound directly, a texture coordinate channel has to be converted into ConvertedWeights first*/
+static FColorVertexBuffer* GetDeformWeightSourceBuffer(FStaticMeshLODResources& LODResource, EDeformMeshWeightSource Source, int32 UVChannel, FColorVertexBuffer* ConvertedWeights)
+{
+	switch (Source)
+	{
+	case EDeformMeshWeightSource::VertexColor:
+		return LODResource.VertexBuffers.ColorVertexBuffer.GetNumVertices() > 0 ? &LODResource.VertexBuffers.ColorVertexBuffer : nullptr;
+	case EDeformMeshWeightSource::TexCoord:
+		return UVChannel >= 0 && UVChannel < (int32)LODResource.VertexBuffers.StaticMeshVertexBuffer.GetNumTexCoords() ? ConvertedWeights : nullptr;
+	default:
+		return nullptr;
+	}
+}
+
+/* Fill a color buffer with deform weights, the weight goes in the red channel*/
+static void InitDeformWeightBuffer(const TArray<float>& Weights, FColorVertexBuffer& OutWeightBuffer)
+{
+	TArray<FColor> Colors;
+	Colors.SetNumUninitialized(Weights.Num());
+	for (int32 VertexIdx = 0; VertexIdx < Weights.Num(); VertexIdx++)
+	{
+		const uint8 Weight = (uint8)FMath::RoundToInt(Weights[VertexIdx] * 255.f);
+		Colors[VertexIdx] = FColor(Weight, Weight, Weight, 255);
+	}
+	OutWeightBuffer.InitFromColorArray(Colors);
+}
+
+/* Convert the deform weights of a static mesh LOD into a color buffer*/
+static void ConvertDeformWeights(const FStaticMeshLODResources& LODResource, EDeformMeshWeightSource Source, int32 UVChannel, FColorVertexBuffer& OutWeightBuffer)
+{
+	TArray<float> Weights;
+	if (GetDeformMeshWeights(LODResource, Source, UVChannel, Weights))
+	{
+		InitDeformWeightBuffer(Weights, OutWeightBuffer);
+	}
+}
+
+bool GetDeformMeshWeights(const FStaticMeshLODResources& LODResource, EDeformMeshWeightSource Source, int32 UVChannel, TArray<float>& OutWeights)
+{
+	const FStaticMeshVertexBuffers& VertexBuffers = LODResource.VertexBuffers;
+	const uint32 NumVertices = VertexBuffers.PositionVertexBuffer.GetNumVertices();
+
+	//Cooked meshes that don't allow CPU access don't have the CPU copy anymore
+	if (Source == EDeformMeshWeightSource::VertexColor && VertexBuffers.ColorVertexBuffer.GetNumVertices() == NumVertices && VertexBuffers.ColorVertexBuffer.GetVertexData())
+	{
+		OutWeights.SetNumUninitialized(NumVertices);
+		for (uint32 VertexIdx = 0; VertexIdx < NumVertices; VertexIdx++)
+		{
+			OutWeights[VertexIdx] = VertexBuffers.ColorVertexBuffer.VertexColor(VertexIdx).R / 255.f;
+		}
+		return true;
+	}
+
+	if (Source == EDeformMeshWeightSource::TexCoord && UVChannel >= 0 && UVChannel < (int32)VertexBuffers.StaticMeshVertexBuffer.GetNumTexCoords() && VertexBuffers.StaticMeshVertexBuffer.GetTexCoordData())
+	{
+		OutWeights.SetNumUninitialized(NumVertices);
+		for (uint32 VertexIdx = 0; VertexIdx < NumVertices; VertexIdx++)
+		{
+			OutWeights[VertexIdx] = FMath::Clamp(VertexBuffers.StaticMeshVertexBuffer.GetVertexUV(VertexIdx, UVChannel).X, 0.f, 1.f);
+		}
+		return true;
+	}
+
+	return false;
+}
+
+/* Replace the hull points of a section with the corners of a box, for the sections that don't have precomputed hull points*/
+static void SetBoxHullPoints(const FBox& Box, TArray<FVector>& OutHullPoints)
+{
+	OutHullPoints.Reset(8);
+	for (int32 Corner = 0; Corner < 8; Corner++)
+	{
+		OutHullPoints.Add(FVector(
+			(Corner & 1) ? Box.Max.X : Box.Min.X,
+			(Corner & 2) ? Box.Max.Y : Box.Min.Y,
+			(Corner & 4) ? Box.Max.Z : Box.Min.Z));
+	}
+}
+
+/* Number of matrices that hold the spline of a section in the structured buffer, after the deform transforms of all the sections*/
+static constexpr int32 NumSplineSlots = 3;
+
+/* Pack the spline of a section into its slots of the structured buffer, the shader reads them as LoadDeformSpline() does*/
+/* The third row of the last slot flags the spline mode, so the slots of a section in transform mode are all zeros*/
+static void PackSplineSlots(const FDeformMeshSection& Section, FMatrix* OutSlots)
+{
+	FVector4 Rows[NumSplineSlots * 4];
+	FMemory::Memzero(Rows);
+	if (Section.DeformMode == EDeformMeshDeformMode::Spline)
+	{
+		FDeformMeshMath::PackSplineParams(Section.SplineParams, Section.SplineForwardAxis, Section.SplineUpDir, FBox(Section.BoundsHullPoints), Rows);
+		Rows[FDeformMeshMath::NumSplineParams] = FVector4(1.f, 0.f, 0.f, 0.f);
+	}
+
+	//Stored transposed like the deform transforms, so each row is one float4 in the shader
+	for (int32 SlotIdx = 0; SlotIdx < NumSplineSlots; SlotIdx++)
+	{
+		const FVector4* SlotRows = &Rows[SlotIdx * 4];
+		OutSlots[SlotIdx] = FMatrix(FPlane(SlotRows[0]), FPlane(SlotRows[1]), FPlane(SlotRows[2]), FPlane(SlotRows[3])).GetTransposed();
+	}
+}
+
+/* Bound a section bent along its spline, the same way USplineMeshComponent::CalcBounds() does*/
+/* The extremes of the curve are found from the roots of its derivative, and the box is padded by the largest cross section of the mesh, scaled and offset*/
+static FBox CalcSplineDeformedBox(const FDeformMeshSection& Section)
+{
+	const FBox MeshBox(Section.BoundsHullPoints);
+	if (!MeshBox.IsValid)
+	{
+		return MeshBox;
+	}
+
+	const FSplineMeshParams& Params = Section.SplineParams;
+	FBox Box(ForceInit);
+	Box += Params.StartPos;
+	Box += Params.EndPos;
+
+	//The derivative of the hermite curve is A*t^2 + B*t + C, with the same coefficients as SplineEvalDir() in the shader
+	const FVector A = (6 * Params.StartPos) + (3 * Params.StartTangent) + (3 * Params.EndTangent) - (6 * Params.EndPos);
+	const FVector B = (-6 * Params.StartPos) - (4 * Params.StartTangent) - (2 * Params.EndTangent) + (6 * Params.EndPos);
+	const FVector C = Params.StartTangent;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		float Roots[2];
+		int32 NumRoots = 0;
+		if (FMath::Abs(A[Axis]) < SMALL_NUMBER)
+		{
+			if (FMath::Abs(B[Axis]) >= SMALL_NUMBER)
+			{
+				Roots[NumRoots++] = -C[Axis] / B[Axis];
+			}
+		}
+		else
+		{
+			const float Discriminant = B[Axis] * B[Axis] - 4 * A[Axis] * C[Axis];
+			if (Discriminant >= 0.f)
+			{
+				const float SqrtDiscriminant = FMath::Sqrt(Discriminant);
+				Roots[NumRoots++] = (-B[Axis] + SqrtDiscriminant) / (2 * A[Axis]);
+				Roots[NumRoots++] = (-B[Axis] - SqrtDiscriminant) / (2 * A[Axis]);
+			}
+		}
+
+		for (int32 RootIdx = 0; RootIdx < NumRoots; RootIdx++)
+		{
+			if (Roots[RootIdx] > 0.f && Roots[RootIdx] < 1.f)
+			{
+				Box += FMath::CubicInterp(Params.StartPos, Params.StartTangent, Params.EndPos, Params.EndTangent, Roots[RootIdx]);
+			}
+		}
+	}
+
+	//The mesh's extent around the forward axis, the slice frame is orthonormal before it's scaled, so a vertex is never further than this from the curve
+	//Scale and offset are interpolated between the two ends, so the largest end bounds them all along the spline
+	const FVector XMask = FDeformMeshMath::GetAxisMask((ESplineMeshAxis::Type)((Section.SplineForwardAxis + 1) % 3));
+	const FVector YMask = FDeformMeshMath::GetAxisMask((ESplineMeshAxis::Type)((Section.SplineForwardAxis + 2) % 3));
+	const float MeshExtentX = FMath::Max(FMath::Abs(FVector::DotProduct(MeshBox.Min, XMask)), FMath::Abs(FVector::DotProduct(MeshBox.Max, XMask)));
+	const float MeshExtentY = FMath::Max(FMath::Abs(FVector::DotProduct(MeshBox.Min, YMask)), FMath::Abs(FVector::DotProduct(MeshBox.Max, YMask)));
+	const float MaxScaleX = FMath::Max(FMath::Abs(Params.StartScale.X), FMath::Abs(Params.EndScale.X));
+	const float MaxScaleY = FMath::Max(FMath::Abs(Params.StartScale.Y), FMath::Abs(Params.EndScale.Y));
+	const float MaxOffset = FMath::Max(Params.StartOffset.Size(), Params.EndOffset.Size());
+
+	return Box.ExpandBy(MaxOffset + FMath::Sqrt(FMath::Square(MaxScaleX * MeshExtentX) + FMath::Square(MaxScaleY * MeshExtentY)));
+}
+
+/* Returns whether one more section can have its resources initialized this frame, the budget is shared by all the deform mesh proxies*/
+static bool ConsumeSectionInitBudget_RenderThread()
+{
+	static uint32 BudgetFrameNumber = 0;
+	static int32 NumSectionInitsThisFrame = 0;
+
+	if (BudgetFrameNumber != GFrameNumberRenderThread)
+	{
+		BudgetFrameNumber = GFrameNumberRenderThread;
+		NumSectionInitsThisFrame = 0;
+	}
+
+	const int32 Budget = CVarDeformMeshMaxSectionInitsPerFrame.GetValueOnRenderThread();
+	if (Budget > 0 && NumSectionInitsThisFrame >= Budget)
+	{
+		return false;
+	}
+	NumSectionInitsThisFrame++;
+	return true;
+}
+
+/* Whether a section is drawn with its baked positions, a section whose freeze task isn't complete is still deformed*/
+static bool IsSectionFrozen(const FDeformMeshSection& Section)
+{
+	return Section.FrozenData.IsValid() && Section.FrozenData->IsFrozen() && Section.StaticMesh && Section.StaticMesh->RenderData;
+}
+
+/* Whether a section of the component gets a section proxy, cleared sections don't have a mesh and frozen sections get a frozen section proxy instead*/
+/* The freeze task completes on a worker, so the caller passes the frozen state that it read once with IsSectionFrozen()*/
+static bool HasSectionProxy(const FDeformMeshSection& Section, bool bSectionFrozen)
+{
+	return (Section.RenderData.IsValid() || (Section.StaticMesh && Section.StaticMesh->RenderData)) && !bSectionFrozen;
 }
 
+/* A mesh batch generated for a section, and the view that it's added to the collector for*/
+struct FDeformMeshBatch
+{
+	FMeshBatch Mesh;
+	int32 ViewIndex;
+};
+
 
 
 ///////////////////////////////////////////////////////////////////////
@@ -246,136 +699,325 @@ public:
 	}
 
 	/* On construction of the Scene proxy, we'll copy all the needed data from the game thread mesh sections to create the needed render thread mesh sections' proxies*/
-	/* We'll also create the structured buffer that will contain the deform transforms of all the sections*/
+	/* Only the cheap data is copied here, the indices are copied by task graph workers and the render resources are created later on the render thread*/
 	FDeformMeshSceneProxy(UDeformMeshComponent* Component)
 		: FPrimitiveSceneProxy(Component)
 		, MaterialRelevance(Component->GetMaterialRelevance(GetScene().GetFeatureLevel()))
+		, TransformsOffset(FDeformMeshTransformPool::InvalidOffset)
+		, NumPendingSections(0)
+		, bAnySectionCastsShadow(false)
 	{
+		DEFORMMESH_SCOPED_TIMING(CreateSceneProxy);
+
 		// Copy each section
 		const uint16 NumSections = Component->DeformMeshSections.Num();
+		INC_DWORD_STAT_BY(STAT_DeformMesh_Sections, NumSections);
 		
-		//Initialize the array of trnasforms and the array of mesh sections proxies
-		DeformTransforms.AddZeroed(NumSections);
+		//The transforms are already stored in a dense array on the game thread, so they're copied as is
+		DeformTransforms = Component->SectionDeformTransforms;
+		//Initialize the array of spline slots and the array of mesh sections proxies
+		SplineSlots.AddZeroed(NumSections * NumSplineSlots);
 		Sections.AddZeroed(NumSections);
+		VisibleSections.Init(false, NumSections);
+		ReadySections.Init(false, NumSections);
+
+		//The pool is allocated once with the exact number of section proxies, so it never reallocates and the pointers to its elements stay valid
+		//Hidden frozen sections don't draw anything, changing their visibility recreates the proxy
+		//A freeze task can complete while we're here, so the frozen state of each section is read only once, and both loops use that snapshot
+		TBitArray<> FrozenSnapshot(false, NumSections);
+		int32 NumSectionProxies = 0;
+		int32 NumFrozenSectionProxies = 0;
+		for (uint16 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+		{
+			const FDeformMeshSection& SrcSection = Component->DeformMeshSections[SectionIdx];
+			const bool bSectionFrozen = IsSectionFrozen(SrcSection);
+			FrozenSnapshot[SectionIdx] = bSectionFrozen;
+			NumSectionProxies += HasSectionProxy(SrcSection, bSectionFrozen) ? 1 : 0;
+			NumFrozenSectionProxies += bSectionFrozen && SrcSection.bSectionVisible ? 1 : 0;
+		}
+		SectionPool.Reserve(NumSectionProxies);
+		FrozenSections.Reserve(NumFrozenSectionProxies);
 
 		for (uint16 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
 		{
 			const FDeformMeshSection& SrcSection = Component->DeformMeshSections[SectionIdx];
+			const bool bSectionFrozen = FrozenSnapshot[SectionIdx];
+			//Cleared sections don't have a mesh, and don't need a proxy
+			if (HasSectionProxy(SrcSection, bSectionFrozen))
 			{
 				//Create a new mesh section proxy
-				FDeformMeshSectionProxy* NewSection = new FDeformMeshSectionProxy(GetScene().GetFeatureLevel());
-
-				//Get the needed data from the static mesh of the mesh section
-				//We're assuming that there's only one LOD
-				auto& LODResource = SrcSection.StaticMesh->RenderData->LODResources[0];
-
-				FDeformMeshVertexFactory* VertexFactory= &NewSection->VertexFactory;
-				//Initialize the vertex factory with the vertex data from the static mesh using the helper function defined above
-				InitVertexFactoryData(VertexFactory, &(LODResource.VertexBuffers));
+				FDeformMeshSectionProxy* NewSection = &SectionPool.Emplace_GetRef(GetScene().GetFeatureLevel());
 
 				//Initialize the additional data using setters (Transform Index and pointer to this scene proxy that holds reference to the structured buffer and its SRV
+				FDeformMeshVertexFactory* VertexFactory= &NewSection->VertexFactory;
 				VertexFactory->SetTransformIndex(SectionIdx);
 				VertexFactory->SetSceneProxy(this);
+				VertexFactory->SetPlayback(&NewSection->Playback);
 
-				//Copy the indices from the static mesh index buffer and use it to initialize the mesh section proxy's index buffer
+				if (SrcSection.RenderData.IsValid())
 				{
-					TArray<uint32> tmp_indices;
-					LODResource.IndexBuffer.GetCopy(tmp_indices);
-					NewSection->IndexBuffer.AppendIndices(tmp_indices.GetData(), tmp_indices.Num());
-					//Initialize the render resource
-					BeginInitResource(&NewSection->IndexBuffer);
+					//The buffers of an asset section are already on the GPU, so there's nothing to prepare, only the vertex factory needs to be initialized
+					NewSection->RenderData = SrcSection.RenderData;
+					NewSection->DrawIndexBuffer = &NewSection->RenderData->IndexBuffer;
+					NewSection->NumPrimitives = NewSection->RenderData->IndexBuffer.GetNumIndices() / 3;
+					NewSection->MaxVertexIndex = NewSection->RenderData->NumVertices - 1;
 				}
+				else
+				{
+					//Get the needed data from the static mesh of the mesh section
+					//We're assuming that there's only one LOD
+					FStaticMeshLODResources& LODResource = SrcSection.StaticMesh->RenderData->LODResources[0];
+
+					//The vertex factory is bound to these vertex buffers when the section is finalized on the render thread
+					NewSection->SourceVertexBuffers = &LODResource.VertexBuffers;
+					NewSection->DrawIndexBuffer = &NewSection->IndexBuffer;
+
+					//The deform weights, the vertex colors are bound as they are, a texture coordinate channel is converted by the prepare task
+					const EDeformMeshWeightSource WeightSource = SrcSection.DeformWeightSource;
+					const int32 WeightUVChannel = SrcSection.DeformWeightUVChannel;
+					NewSection->WeightSourceBuffer = GetDeformWeightSourceBuffer(LODResource, WeightSource, WeightUVChannel, &NewSection->WeightBuffer);
+
+					//The shadow depth passes use a lower LOD if the component has a shadow LOD bias and the mesh has that LOD
+					FRawStaticIndexBuffer* SrcShadowIndexBuffer = nullptr;
+					FStaticMeshLODResources* ShadowLODResource = nullptr;
+					const int32 ShadowLODIndex = FMath::Min(Component->ShadowLODBias, SrcSection.StaticMesh->RenderData->LODResources.Num() - 1);
+					if (ShadowLODIndex > 0)
+					{
+						ShadowLODResource = &SrcSection.StaticMesh->RenderData->LODResources[ShadowLODIndex];
+						NewSection->ShadowSourceVertexBuffers = &ShadowLODResource->VertexBuffers;
+						NewSection->ShadowMaxVertexIndex = ShadowLODResource->VertexBuffers.PositionVertexBuffer.GetNumVertices() - 1;
+						NewSection->ShadowVertexFactory.SetTransformIndex(SectionIdx);
+						NewSection->ShadowVertexFactory.SetSceneProxy(this);
+						NewSection->ShadowWeightSourceBuffer = GetDeformWeightSourceBuffer(*ShadowLODResource, WeightSource, WeightUVChannel, &NewSection->ShadowWeightBuffer);
+						SrcShadowIndexBuffer = &ShadowLODResource->IndexBuffer;
+					}
 
-				//Fill the array of transforms with the transform matrix from each section
-				DeformTransforms[SectionIdx] = SrcSection.DeformTransform;
+					//Copying the indices and building the index buffer's CPU data is the expensive part, so it's done on a worker thread
+					//Nothing else touches the section's index and weight buffers until the task is complete
+					FRawStaticIndexBuffer* SrcIndexBuffer = &LODResource.IndexBuffer;
+					const FStaticMeshLODResources* SrcLODResource = &LODResource;
+					NewSection->PrepareTask = FFunctionGraphTask::CreateAndDispatchWhenReady(
+						[NewSection, SrcIndexBuffer, SrcShadowIndexBuffer, SrcLODResource, ShadowLODResource, WeightSource, WeightUVChannel]()
+						{
+							TArray<uint32> tmp_indices;
+							SrcIndexBuffer->GetCopy(tmp_indices);
+							NewSection->IndexBuffer.AppendIndices(tmp_indices.GetData(), tmp_indices.Num());
+							if (SrcShadowIndexBuffer)
+							{
+								SrcShadowIndexBuffer->GetCopy(tmp_indices);
+								NewSection->ShadowIndexBuffer.AppendIndices(tmp_indices.GetData(), tmp_indices.Num());
+							}
+
+							if (NewSection->WeightSourceBuffer == &NewSection->WeightBuffer)
+							{
+								ConvertDeformWeights(*SrcLODResource, WeightSource, WeightUVChannel, NewSection->WeightBuffer);
+							}
+							if (NewSection->ShadowWeightSourceBuffer == &NewSection->ShadowWeightBuffer)
+							{
+								ConvertDeformWeights(*ShadowLODResource, WeightSource, WeightUVChannel, NewSection->ShadowWeightBuffer);
+							}
+						},
+						TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+
+					//Set the max vertex index for this mesh section
+					NewSection->MaxVertexIndex = LODResource.VertexBuffers.PositionVertexBuffer.GetNumVertices() - 1;
+				}
+				NumPendingSections++;
 
-				//Set the max vertex index for this mesh section
-				NewSection->MaxVertexIndex = LODResource.VertexBuffers.PositionVertexBuffer.GetNumVertices() - 1;
+				//Fill the array of spline slots with the spline of each section
+				PackSplineSlots(SrcSection, &SplineSlots[SectionIdx * NumSplineSlots]);
 
 				//Get the material of this section
 				NewSection->Material = Component->GetMaterial(SectionIdx);
 
-				if (NewSection->Material == NULL)
+				//Materials that are not allowed in the deform mesh settings may not have the deform mesh shaders, so they fall back to the default material too
+				if (NewSection->Material == NULL || !GetDefault<UDeformMeshSettings>()->IsMaterialAllowed(NewSection->Material))
 				{
 					NewSection->Material = UMaterial::GetDefaultMaterial(MD_Surface);
 				}
 
 				// Copy visibility info
-				NewSection->bSectionVisible = SrcSection.bSectionVisible;
+				VisibleSections[SectionIdx] = SrcSection.bSectionVisible;
+				NewSection->bCastShadow = SrcSection.bCastShadow;
+
+				// Copy the baked animation
+				if (SrcSection.Animation)
+				{
+					NewSection->Playback.RenderData = SrcSection.Animation->GetRenderData();
+					NewSection->Playback.StartTime = SrcSection.AnimationStartTime;
+					NewSection->Playback.PlayRate = SrcSection.AnimationPlayRate;
+					NewSection->Playback.bLoop = SrcSection.bLoopAnimation;
+				}
 
 				// Save ref to new section
 				Sections[SectionIdx] = NewSection;
 			}
+			else if (bSectionFrozen && SrcSection.bSectionVisible)
+			{
+				//Frozen sections don't have a deform section proxy, so the updates of their transform, spline and visibility don't reach them
+				FDeformMeshFrozenSectionProxy& FrozenSection = FrozenSections.Emplace_GetRef(GetScene().GetFeatureLevel());
+				FStaticMeshLODResources& LODResource = SrcSection.StaticMesh->RenderData->LODResources[0];
+				FrozenSection.FrozenData = SrcSection.FrozenData;
+				FrozenSection.SourceVertexBuffers = &LODResource.VertexBuffers;
+				FrozenSection.IndexBuffer = &LODResource.IndexBuffer;
+				//The freeze task is complete, so the converted weights are already there if the section needed them
+				FrozenSection.WeightSourceBuffer = GetDeformWeightSourceBuffer(LODResource, SrcSection.DeformWeightSource, SrcSection.DeformWeightUVChannel, &SrcSection.FrozenData->WeightBuffer);
+				if (FrozenSection.WeightSourceBuffer && FrozenSection.WeightSourceBuffer->GetNumVertices() == 0)
+				{
+					FrozenSection.WeightSourceBuffer = nullptr;
+				}
+				FrozenSection.bCastShadow = SrcSection.bCastShadow;
+
+				//Any surface material can be drawn with the local vertex factory, the deform mesh settings don't apply
+				FrozenSection.Material = Component->GetMaterial(SectionIdx);
+				if (FrozenSection.Material == NULL)
+				{
+					FrozenSection.Material = UMaterial::GetDefaultMaterial(MD_Surface);
+				}
+			}
 		}
 
-		//Create the structured buffer only if we have at least one section
+		UpdateAnySectionCastsShadow();
+	}
+
+	/* Called on the render thread when the proxy is added to the scene, we allocate the range of the transform pool that will contain the deform transforms of all the sections here*/
+	virtual void CreateRenderThreadResources() override
+	{
+		//Allocate a range only if we have at least one section
+		const int32 NumSections = DeformTransforms.Num();
 		if(NumSections > 0)
 		{
-			///////////////////////////////////////////////////////////////
-			//// CREATING THE STRUCTURED BUFFER FOR THE DEFORM TRANSFORMS OF ALL THE SECTIONS
-			//We'll use one structured buffer for all the mesh sections of the component
-
-			//We first create a resource array to use it in the create info for initializing the structured buffer on creation
-			TResourceArray<FMatrix>* ResourceArray = new TResourceArray<FMatrix>(true);
-			FRHIResourceCreateInfo CreateInfo;
-			ResourceArray->Append(DeformTransforms);
-			CreateInfo.ResourceArray = ResourceArray;
-			//Set the debug name so we can find the resource when debugging in RenderDoc
-			CreateInfo.DebugName = TEXT("DeformMesh_TransformsSB");
-
-			DeformTransformsSB = RHICreateStructuredBuffer(sizeof(FMatrix), NumSections * sizeof(FMatrix), BUF_ShaderResource, CreateInfo);
-			bDeformTransformsDirty = false;
-			///////////////////////////////////////////////////////////////
-			//// CREATING AN SRV FOR THE STRUCTUED BUFFER SO WA CAN USE IT AS A SHADER RESOURCE PARAMETER AND BIND IT TO THE VERTEX FACTORY
-			DeformTransformsSRV = RHICreateShaderResourceView(DeformTransformsSB);
+			//All the proxies share the structured buffer of the transform pool, our range holds the transforms of our sections, followed by their splines
+			//It's uploaded with the dirty ranges of the other proxies, before the first deform mesh is drawn
+			TransformsOffset = GDeformMeshTransformPool.Allocate(NumSections + SplineSlots.Num());
+			GDeformMeshTransformPool.Write(TransformsOffset, DeformTransforms.GetData(), NumSections);
+			GDeformMeshTransformPool.Write(TransformsOffset + NumSections, SplineSlots.GetData(), SplineSlots.Num());
+		}
 
-			///////////////////////////////////////////////////////////////
+		//The static mesh batches of the frozen sections are cached right after this, so their vertex factories must be ready
+		for (FDeformMeshFrozenSectionProxy& FrozenSection : FrozenSections)
+		{
+			InitVertexFactoryData_RenderThread(FrozenSection);
 		}
 	}
 
 	virtual ~FDeformMeshSceneProxy()
 	{
+		DEC_DWORD_STAT_BY(STAT_DeformMesh_Sections, Sections.Num());
+
 		//For each section , release the render resources
 		for (FDeformMeshSectionProxy* Section : Sections)
 		{
 			if (Section != nullptr)
 			{
+				//The worker could still be writing to the index buffer
+				if (Section->PrepareTask.IsValid() && !Section->PrepareTask->IsComplete())
+				{
+					FTaskGraphInterface::Get().WaitUntilTaskCompletes(Section->PrepareTask, ENamedThreads::GetRenderThread_Local());
+				}
+
 				Section->IndexBuffer.ReleaseResource();
 				Section->VertexFactory.ReleaseResource();
-				delete Section;
+				Section->ShadowIndexBuffer.ReleaseResource();
+				Section->ShadowVertexFactory.ReleaseResource();
+				Section->WeightBuffer.ReleaseResource();
+				Section->ShadowWeightBuffer.ReleaseResource();
 			}
 		}
+		Sections.Empty();
+		SectionPool.Empty();
+
+		//The baked positions belong to the frozen render data, they're released with it
+		for (FDeformMeshFrozenSectionProxy& FrozenSection : FrozenSections)
+		{
+			FrozenSection.VertexFactory.ReleaseResource();
+		}
+		FrozenSections.Empty();
 
-		//Release the structured buffer and the SRV
-		DeformTransformsSB.SafeRelease();
-		DeformTransformsSRV.SafeRelease();
+		//Give our range back to the transform pool
+		if (HasTransformsRange())
+		{
+			GDeformMeshTransformPool.Free(TransformsOffset, DeformTransforms.Num() + SplineSlots.Num());
+		}
 	}
 
 
-	/* Update the transforms structured buffer using the array of deform transform, this will update the array on the GPU*/
-	void UpdateDeformTransformsSB_RenderThread()
+	/* Initialize the render resources of the sections whose preparation task is complete, within the per frame budget*/
+	void FinalizePendingSections_RenderThread()
 	{
 		check(IsInRenderingThread());
-		//Update the structured buffer only if it needs update
-		if(bDeformTransformsDirty && DeformTransformsSB)
+		if (NumPendingSections == 0)
+		{
+			return;
+		}
+
+		for (int32 SectionIdx = 0; SectionIdx < Sections.Num(); SectionIdx++)
 		{
-			void* StructuredBufferData = RHILockStructuredBuffer(DeformTransformsSB, 0, DeformTransforms.Num() * sizeof(FMatrix), RLM_WriteOnly);
-			FMemory::Memcpy(StructuredBufferData, DeformTransforms.GetData(), DeformTransforms.Num() * sizeof(FMatrix));
-			RHIUnlockStructuredBuffer(DeformTransformsSB);
-			bDeformTransformsDirty = false;
+			FDeformMeshSectionProxy* Section = Sections[SectionIdx];
+			if (Section != nullptr && !ReadySections[SectionIdx] &&
+				(!Section->PrepareTask.IsValid() || Section->PrepareTask->IsComplete()))
+			{
+				if (!ConsumeSectionInitBudget_RenderThread())
+				{
+					break;
+				}
+
+				if (Section->RenderData.IsValid())
+				{
+					InitVertexFactoryData_RenderThread(&Section->VertexFactory, *Section->RenderData);
+				}
+				else
+				{
+					InitVertexFactoryData_RenderThread(&Section->VertexFactory, Section->SourceVertexBuffers, Section->WeightSourceBuffer);
+					Section->IndexBuffer.InitResource();
+					Section->NumPrimitives = Section->IndexBuffer.GetNumIndices() / 3;
+
+					if (Section->HasShadowLOD())
+					{
+						InitVertexFactoryData_RenderThread(&Section->ShadowVertexFactory, Section->ShadowSourceVertexBuffers, Section->ShadowWeightSourceBuffer);
+						Section->ShadowIndexBuffer.InitResource();
+						Section->ShadowNumPrimitives = Section->ShadowIndexBuffer.GetNumIndices() / 3;
+					}
+				}
+				Section->PrepareTask = nullptr;
+				ReadySections[SectionIdx] = true;
+				NumPendingSections--;
+			}
 		}
 	}
 
-	/* Update the deform transform that is being used to deform this mesh section, this will just update this section's entry in the CPU array*/
+	/* Update the deform transform that is being used to deform this mesh section, this will just update this section's entry in the CPU array and in the transform pool*/
+	/* Before CreateRenderThreadResources() the whole array is written to the pool when our range is allocated*/
 	void UpdateDeformTransform_RenderThread(int32 SectionIndex, FMatrix Transform)
 	{
 		check(IsInRenderingThread());
-		if (SectionIndex < Sections.Num() &&
+		if (Sections.IsValidIndex(SectionIndex) &&
 			Sections[SectionIndex] != nullptr)
 		{
 			DeformTransforms[SectionIndex] = Transform;
-			//Mark as dirty
-			bDeformTransformsDirty = true;
+			if (HasTransformsRange())
+			{
+				GDeformMeshTransformPool.Write(TransformsOffset + SectionIndex, &Transform, 1);
+			}
+		}
+	}
+
+	/* Same as above, for a batch of sections*/
+	void UpdateDeformTransforms_RenderThread(const FDeformMeshTransformUpdate* Updates, int32 NumUpdates)
+	{
+		check(IsInRenderingThread());
+		for (int32 UpdateIdx = 0; UpdateIdx < NumUpdates; UpdateIdx++)
+		{
+			const FDeformMeshTransformUpdate& Update = Updates[UpdateIdx];
+			if (Sections.IsValidIndex(Update.SectionIndex) &&
+				Sections[Update.SectionIndex] != nullptr)
+			{
+				DeformTransforms[Update.SectionIndex] = Update.DeformTransform;
+				if (HasTransformsRange())
+				{
+					GDeformMeshTransformPool.Write(TransformsOffset + Update.SectionIndex, &Update.DeformTransform, 1);
+				}
+			}
 		}
 	}
 
@@ -384,37 +1026,185 @@ public:
 	{
 		check(IsInRenderingThread());
 
-		if (SectionIndex < Sections.Num() &&
+		if (Sections.IsValidIndex(SectionIndex) &&
 			Sections[SectionIndex] != nullptr)
 		{
-			Sections[SectionIndex]->bSectionVisible = bNewVisibility;
+			VisibleSections[SectionIndex] = bNewVisibility;
 		}
 	}
 
-	/* Given the scene views and the visibility map, we add to the collector the relevant dynamic meshes that need to be rendered by this component*/
-	virtual void GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const override
+	/* Update the visibility of the first sections at once, bit N of the array is the visibility of section N*/
+	void SetSectionsVisibility_RenderThread(const TBitArray<>& NewVisibility)
 	{
-		// Set up wireframe material (if needed)
-		const bool bWireframe = AllowDebugViewmodes() && ViewFamily.EngineShowFlags.Wireframe;
+		check(IsInRenderingThread());
 
-		FColoredMaterialRenderProxy* WireframeMaterialInstance = NULL;
-		if (bWireframe)
+		//Whole words are copied, only the last word is merged with the bits of the sections that are not in the array
+		const int32 NumBits = FMath::Min(NewVisibility.Num(), VisibleSections.Num());
+		const int32 NumFullWords = NumBits / NumBitsPerDWORD;
+		uint32* DstWords = VisibleSections.GetData();
+		const uint32* SrcWords = NewVisibility.GetData();
+		FMemory::Memcpy(DstWords, SrcWords, NumFullWords * sizeof(uint32));
+		if (const int32 NumRemainingBits = NumBits % NumBitsPerDWORD)
 		{
-			WireframeMaterialInstance = new FColoredMaterialRenderProxy(
-				GEngine->WireframeMaterial ? GEngine->WireframeMaterial->GetRenderProxy() : NULL,
-				FLinearColor(0, 0.5f, 1.f)
-			);
+			const uint32 Mask = (1u << NumRemainingBits) - 1;
+			DstWords[NumFullWords] = (DstWords[NumFullWords] & ~Mask) | (SrcWords[NumFullWords] & Mask);
+		}
+	}
 
-			Collector.RegisterOneFrameMaterialProxy(WireframeMaterialInstance);
+	/* Update whether the mesh section is drawn in the shadow depth passes*/
+	void SetSectionCastShadow_RenderThread(int32 SectionIndex, bool bNewCastShadow)
+	{
+		check(IsInRenderingThread());
+
+		if (Sections.IsValidIndex(SectionIndex) &&
+			Sections[SectionIndex] != nullptr)
+		{
+			Sections[SectionIndex]->bCastShadow = bNewCastShadow;
+			UpdateAnySectionCastsShadow();
 		}
+	}
 
-		// Iterate over sections
-		for (const FDeformMeshSectionProxy* Section : Sections)
+	/* Update the deform mode and the spline of a section, only this section's spline slots are written to the pool*/
+	void SetSectionSplineSlots_RenderThread(int32 SectionIndex, const FMatrix* NewSlots)
+	{
+		check(IsInRenderingThread());
+
+		if (Sections.IsValidIndex(SectionIndex) &&
+			Sections[SectionIndex] != nullptr)
 		{
-			if (Section != nullptr && Section->bSectionVisible)
+			FMemory::Memcpy(&SplineSlots[SectionIndex * NumSplineSlots], NewSlots, NumSplineSlots * sizeof(FMatrix));
+
+			//Before CreateRenderThreadResources() the slots are written with the rest of our range
+			if (HasTransformsRange())
 			{
-				//Get the section's materil, or the wireframe material if we're rendering in wireframe mode
-				FMaterialRenderProxy* MaterialProxy = bWireframe ? WireframeMaterialInstance : Section->Material->GetRenderProxy();
+				GDeformMeshTransformPool.Write(GetSplineSlotsIndex(SectionIndex), NewSlots, NumSplineSlots);
+			}
+		}
+	}
+
+	/* Start or stop (With an invalid render data) the baked animation of a section*/
+	void SetSectionPlayback_RenderThread(int32 SectionIndex, const FDeformMeshSectionPlayback& NewPlayback)
+	{
+		check(IsInRenderingThread());
+
+		if (Sections.IsValidIndex(SectionIndex) &&
+			Sections[SectionIndex] != nullptr)
+		{
+			Sections[SectionIndex]->Playback = NewPlayback;
+		}
+	}
+
+	/* When no section casts shadows, the proxy isn't relevant to the shadow passes at all, so it's not even gathered for them*/
+	void UpdateAnySectionCastsShadow()
+	{
+		bAnySectionCastsShadow = false;
+		for (const FDeformMeshFrozenSectionProxy& FrozenSection : FrozenSections)
+		{
+			bAnySectionCastsShadow |= FrozenSection.bCastShadow;
+		}
+		for (const FDeformMeshSectionProxy* Section : Sections)
+		{
+			if (Section != nullptr && Section->bCastShadow)
+			{
+				bAnySectionCastsShadow = true;
+				break;
+			}
+		}
+	}
+
+	/* Given the scene views and the visibility map, we add to the collector the relevant dynamic meshes that need to be rendered by this component*/
+	virtual void GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const override
+	{
+		DEFORMMESH_SCOPED_TIMING(GetDynamicMeshElements);
+		int32 NumDraws = 0;
+
+		//This is the only per frame render thread entry point of the proxy, so this is where the sections that became ready get their resources
+		const_cast<FDeformMeshSceneProxy*>(this)->FinalizePendingSections_RenderThread();
+
+		//The first proxy drawn in a frame uploads the transforms updated by all the proxies, it's a no-op for the others
+		GDeformMeshTransformPool.Flush_RenderThread();
+
+		// Set up wireframe material (if needed)
+		const bool bWireframe = AllowDebugViewmodes() && ViewFamily.EngineShowFlags.Wireframe;
+
+		FColoredMaterialRenderProxy* WireframeMaterialInstance = NULL;
+		if (bWireframe)
+		{
+			WireframeMaterialInstance = new FColoredMaterialRenderProxy(
+				GEngine->WireframeMaterial ? GEngine->WireframeMaterial->GetRenderProxy() : NULL,
+				FLinearColor(0, 0.5f, 1.f)
+			);
+
+			Collector.RegisterOneFrameMaterialProxy(WireframeMaterialInstance);
+		}
+
+		//The primitive uniform buffer is the same for every section and every view, so it's allocated once
+		//The LocalVertexFactory uses a uniform buffer to pass primitve data like the local to world transform for this frame and for the previous one
+		//Most of this data can be fetched using the helper function below
+		bool bHasPrecomputedVolumetricLightmap;
+		FMatrix PreviousLocalToWorld;
+		int32 SingleCaptureIndex;
+		bool bOutputVelocity;
+		GetScene().GetPrimitiveUniformShaderParameters_RenderThread(GetPrimitiveSceneInfo(), bHasPrecomputedVolumetricLightmap, PreviousLocalToWorld, SingleCaptureIndex, bOutputVelocity);
+		FDynamicPrimitiveUniformBuffer& DynamicPrimitiveUniformBuffer = Collector.AllocateOneFrameResource<FDynamicPrimitiveUniformBuffer>();
+		DynamicPrimitiveUniformBuffer.Set(GetLocalToWorld(), PreviousLocalToWorld, GetBounds(), GetLocalBounds(), true, bHasPrecomputedVolumetricLightmap, DrawsVelocity(), bOutputVelocity);
+
+		//The collector isn't thread safe, so the batches are filled into one array per chunk of sections, then added to the collector in section order
+		//Components with few sections use a single chunk, filled on the render thread
+		const int32 NumSections = Sections.Num();
+		const int32 MinSectionsPerChunk = FMath::Max(1, CVarDeformMeshParallelBatchMinSections.GetValueOnRenderThread());
+		const int32 MaxChunks = FApp::ShouldUseThreadingForPerformance() ? FTaskGraphInterface::Get().GetNumWorkerThreads() + 1 : 1;
+		const int32 NumChunks = FMath::Clamp(NumSections / MinSectionsPerChunk, 1, MaxChunks);
+		//Chunks are made of whole words of the section bit masks, so they don't share any word
+		const int32 SectionsPerChunk = Align(FMath::DivideAndRoundUp(NumSections, NumChunks), NumBitsPerDWORD);
+
+		TArray<TArray<FDeformMeshBatch>, TInlineAllocator<16>> ChunkBatches;
+		ChunkBatches.SetNum(NumChunks);
+		ParallelFor(NumChunks, [&](int32 ChunkIndex)
+			{
+				const int32 FirstSection = ChunkIndex * SectionsPerChunk;
+				const int32 LastSection = FMath::Min(FirstSection + SectionsPerChunk, NumSections);
+				GenerateSectionBatches(FirstSection, LastSection, Views, VisibilityMap, WireframeMaterialInstance, DynamicPrimitiveUniformBuffer, ChunkBatches[ChunkIndex]);
+			},
+			NumChunks == 1);
+
+		for (const TArray<FDeformMeshBatch>& Batches : ChunkBatches)
+		{
+			for (const FDeformMeshBatch& Batch : Batches)
+			{
+				//Add the batch to the collector
+				FMeshBatch& Mesh = Collector.AllocateMesh();
+				Mesh = Batch.Mesh;
+				Collector.AddMesh(Batch.ViewIndex, Mesh);
+			}
+			NumDraws += Batches.Num();
+		}
+
+		DEFORMMESH_COUNTER_ADD(Draws, NumDraws);
+	}
+
+	/* Fill the mesh batches of a range of sections for all the views, this may run on a task graph worker so it only reads the proxy*/
+	/* A null wireframe material means that we're not rendering in wireframe mode*/
+	void GenerateSectionBatches(int32 FirstSection, int32 LastSection, const TArray<const FSceneView*>& Views, uint32 VisibilityMap,
+		FMaterialRenderProxy* WireframeMaterialInstance, FDynamicPrimitiveUniformBuffer& DynamicPrimitiveUniformBuffer, TArray<FDeformMeshBatch>& OutBatches) const
+	{
+		DEFORMMESH_SCOPED_TIMING(GenerateSectionBatches);
+		const bool bWireframe = WireframeMaterialInstance != nullptr;
+
+		//The range starts on a word boundary, so the words of the visible and finalized sections are scanned directly
+		//Count trailing zeros jumps to the next section to draw, the hidden and unfinished sections are never touched
+		const uint32* VisibleWords = VisibleSections.GetData();
+		const uint32* ReadyWords = ReadySections.GetData();
+		const int32 LastWord = FMath::DivideAndRoundUp(LastSection, NumBitsPerDWORD);
+		for (int32 WordIdx = FirstSection / NumBitsPerDWORD; WordIdx < LastWord; WordIdx++)
+		{
+			for (uint32 DrawableBits = VisibleWords[WordIdx] & ReadyWords[WordIdx]; DrawableBits != 0; DrawableBits &= DrawableBits - 1)
+			{
+				const int32 SectionIdx = WordIdx * NumBitsPerDWORD + FMath::CountTrailingZeros(DrawableBits);
+				const FDeformMeshSectionProxy* Section = Sections[SectionIdx];
+
+				//Get the section's materil, or the wireframe material if we're rendering in wireframe mode
+				FMaterialRenderProxy* MaterialProxy = bWireframe ? WireframeMaterialInstance : Section->Material->GetRenderProxy();
 
 				// For each view..
 				for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
@@ -422,53 +1212,87 @@ public:
 					//Check if our mesh is visible from this view
 					if (VisibilityMap & (1 << ViewIndex))
 					{
-						const FSceneView* View = Views[ViewIndex];
-						// Allocate a mesh batch and get a ref to the first element
-						FMeshBatch& Mesh = Collector.AllocateMesh();
+						// Add a mesh batch and get a ref to the first element
+						FDeformMeshBatch& Batch = OutBatches.AddDefaulted_GetRef();
+						Batch.ViewIndex = ViewIndex;
+						FMeshBatch& Mesh = Batch.Mesh;
 						FMeshBatchElement& BatchElement = Mesh.Elements[0];
 						//Fill this batch element with the mesh section's render data
-						BatchElement.IndexBuffer = &Section->IndexBuffer;
+						BatchElement.IndexBuffer = Section->DrawIndexBuffer;
 						Mesh.bWireframe = bWireframe;
 						Mesh.VertexFactory = &Section->VertexFactory;
 						Mesh.MaterialRenderProxy = MaterialProxy;
 
-						//The LocalVertexFactory uses a uniform buffer to pass primitve data like the local to world transform for this frame and for the previous one
-						//Most of this data can be fetched using the helper function below
-						bool bHasPrecomputedVolumetricLightmap;
-						FMatrix PreviousLocalToWorld;
-						int32 SingleCaptureIndex;
-						bool bOutputVelocity;
-						GetScene().GetPrimitiveUniformShaderParameters_RenderThread(GetPrimitiveSceneInfo(), bHasPrecomputedVolumetricLightmap, PreviousLocalToWorld, SingleCaptureIndex, bOutputVelocity);
-						//Alloate a temporary primitive uniform buffer, fill it with the data and set it in the batch element
-						FDynamicPrimitiveUniformBuffer& DynamicPrimitiveUniformBuffer = Collector.AllocateOneFrameResource<FDynamicPrimitiveUniformBuffer>();
-						DynamicPrimitiveUniformBuffer.Set(GetLocalToWorld(), PreviousLocalToWorld, GetBounds(), GetLocalBounds(), true, bHasPrecomputedVolumetricLightmap, DrawsVelocity(), bOutputVelocity);
 						BatchElement.PrimitiveUniformBufferResource = &DynamicPrimitiveUniformBuffer.UniformBuffer;
 						BatchElement.PrimitiveIdMode = PrimID_DynamicPrimitiveShaderData;
 
 						//Additional data 
 						BatchElement.FirstIndex = 0;
-						BatchElement.NumPrimitives = Section->IndexBuffer.GetNumIndices() / 3;
+						BatchElement.NumPrimitives = Section->NumPrimitives;
 						BatchElement.MinVertexIndex = 0;
 						BatchElement.MaxVertexIndex = Section->MaxVertexIndex;
 						Mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
 						Mesh.Type = PT_TriangleList;
 						Mesh.DepthPriorityGroup = SDPG_World;
 						Mesh.bCanApplyViewModeOverrides = false;
-
-						//Add the batch to the collector
-						Collector.AddMesh(ViewIndex, Mesh);
+						//Sections with a shadow LOD cast their shadow with the batch below instead
+						//The offsets of a baked animation are per vertex of the section's own geometry, so a playing section casts its shadow with it
+						const bool bUseShadowLOD = Section->HasShadowLOD() && !bWireframe && !Section->Playback.IsPlaying();
+						Mesh.CastShadow = Section->bCastShadow && !bUseShadowLOD;
+
+						//The shadow LOD batch is only used by the shadow depth passes, it's filtered out of all the other passes
+						if (bUseShadowLOD && Section->bCastShadow)
+						{
+							//Copy the batch before adding the shadow one, adding may reallocate the array
+							FDeformMeshBatch ShadowBatch = Batch;
+							FMeshBatch& ShadowMesh = ShadowBatch.Mesh;
+							ShadowMesh.VertexFactory = &Section->ShadowVertexFactory;
+							ShadowMesh.Elements[0].IndexBuffer = &Section->ShadowIndexBuffer;
+							ShadowMesh.Elements[0].NumPrimitives = Section->ShadowNumPrimitives;
+							ShadowMesh.Elements[0].MaxVertexIndex = Section->ShadowMaxVertexIndex;
+							ShadowMesh.CastShadow = true;
+							ShadowMesh.bUseForMaterial = false;
+							ShadowMesh.bUseForDepthPass = false;
+							ShadowMesh.bUseAsOccluder = false;
+							OutBatches.Add(MoveTemp(ShadowBatch));
+						}
 					}
 				}
 			}
 		}
 	}
 
+	/* Called on the render thread when the proxy is added to the scene, the frozen sections are drawn with static mesh batches that the renderer caches*/
+	virtual void DrawStaticElements(FStaticPrimitiveDrawInterface* PDI) override
+	{
+		for (const FDeformMeshFrozenSectionProxy& FrozenSection : FrozenSections)
+		{
+			FMeshBatch Mesh;
+			FMeshBatchElement& BatchElement = Mesh.Elements[0];
+			//The primitive uniform buffer isn't set, the renderer uses the one of the proxy for static batches
+			BatchElement.IndexBuffer = FrozenSection.IndexBuffer;
+			BatchElement.FirstIndex = 0;
+			BatchElement.NumPrimitives = FrozenSection.IndexBuffer->GetNumIndices() / 3;
+			BatchElement.MinVertexIndex = 0;
+			BatchElement.MaxVertexIndex = FrozenSection.FrozenData->PositionBuffer.GetNumVertices() - 1;
+			Mesh.VertexFactory = &FrozenSection.VertexFactory;
+			Mesh.MaterialRenderProxy = FrozenSection.Material->GetRenderProxy();
+			Mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
+			Mesh.Type = PT_TriangleList;
+			Mesh.DepthPriorityGroup = SDPG_World;
+			Mesh.LODIndex = 0;
+			Mesh.CastShadow = FrozenSection.bCastShadow;
+			PDI->DrawMesh(Mesh, FLT_MAX);
+		}
+	}
+
 	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const
 	{
 		FPrimitiveViewRelevance Result;
 		Result.bDrawRelevance = IsShown(View);
-		Result.bShadowRelevance = IsShadowCast(View);
+		Result.bShadowRelevance = IsShadowCast(View) && bAnySectionCastsShadow;
 		Result.bDynamicRelevance = true;
+		Result.bStaticRelevance = FrozenSections.Num() > 0;
 		Result.bRenderInMainPass = ShouldRenderInMainPass();
 		Result.bUsesLightingChannels = GetLightingChannelMask() != GetDefaultLightingChannelMask();
 		Result.bRenderCustomDepth = ShouldRenderCustomDepth();
@@ -493,28 +1317,49 @@ public:
 		return(FPrimitiveSceneProxy::GetAllocatedSize());
 	}
 
-	//Getter to the SRV of the transforms structured buffer
-	inline FShaderResourceViewRHIRef& GetDeformTransformsSRV() { return DeformTransformsSRV; }
+	//Getter to the SRV of the transforms structured buffer, shared by all the proxies
+	inline FShaderResourceViewRHIRef& GetDeformTransformsSRV() { return GDeformMeshTransformPool.GetSRV(); }
+
+	//Index of the deform transform of a section in the transforms structured buffer, our range starts at TransformsOffset
+	inline uint32 GetTransformIndex(uint32 SectionIndex) const { return TransformsOffset + SectionIndex; }
+
+	//Index of the first spline slot of a section in the transforms structured buffer
+	inline uint32 GetSplineSlotsIndex(uint32 SectionIndex) const { return TransformsOffset + DeformTransforms.Num() + SectionIndex * NumSplineSlots; }
+
+	//Whether our range of the transform pool is allocated, it is from CreateRenderThreadResources() on
+	inline bool HasTransformsRange() const { return TransformsOffset != FDeformMeshTransformPool::InvalidOffset; }
 
 private:
-	/** Array of sections */
+	/** Array of sections, indexed like the sections of the component. Null for the cleared sections */
 	TArray<FDeformMeshSectionProxy*> Sections;
 
+	/** The storage of all the section proxies, the pointers of the array above point into it */
+	TArray<FDeformMeshSectionProxy> SectionPool;
+
+	/** The visible frozen sections, drawn as static meshes */
+	TArray<FDeformMeshFrozenSectionProxy> FrozenSections;
+
+	//One bit per section: whether it's visible, and whether its render resources are initialized so it can be rendered
+	TBitArray<> VisibleSections;
+	TBitArray<> ReadySections;
+
 	FMaterialRelevance MaterialRelevance;
 
 	//The render thread array of transforms of all the sections
-	//Individual updates of each section's deform transform will just update the entry in this array
-	//Before binding the SRV, we update the content of the structured buffer with this updated array
+	//Individual updates of each section's deform transform update the entry in this array, and in our range of the transform pool that gets uploaded
 	TArray<FMatrix> DeformTransforms;
 
-	//The structured buffer that will contain all the deform transoform and going to be used as a shader resource
-	FStructuredBufferRHIRef DeformTransformsSB;
+	//The render thread array of the spline slots of all the sections, NumSplineSlots matrices per section
+	TArray<FMatrix> SplineSlots;
 
-	//The shader resource view of the structured buffer, this is what we bind to the vertex factory shader
-	FShaderResourceViewRHIRef DeformTransformsSRV;
+	//The first matrix of our range in the transform pool, the transforms come first and then the spline slots
+	uint32 TransformsOffset;
 
-	//Whether the structured buffer needs to be updated or not
-	bool bDeformTransformsDirty;
+	//Number of sections that are not finalized yet
+	int32 NumPendingSections;
+
+	//Whether at least one section casts shadows
+	bool bAnySectionCastsShadow;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -540,6 +1385,11 @@ public:
 		/* Otherwise, the shader compiler will complain when this parameter is not present in the shader file*/
 		TransformIndex.Bind(ParameterMap, TEXT("DMTransformIndex"), SPF_Optional);
 		TransformsSRV.Bind(ParameterMap, TEXT("DMTransforms"), SPF_Optional);
+		SplineIndex.Bind(ParameterMap, TEXT("DMSplineIndex"), SPF_Optional);
+		AnimFrames.Bind(ParameterMap, TEXT("DMAnimFrames"), SPF_Optional);
+		AnimParams.Bind(ParameterMap, TEXT("DMAnimParams"), SPF_Optional);
+		AnimOffsetsSRV.Bind(ParameterMap, TEXT("DMAnimOffsets"), SPF_Optional);
+		AnimScalesSRV.Bind(ParameterMap, TEXT("DMAnimScales"), SPF_Optional);
 	};
 
 	void GetElementShaderBindings(
@@ -567,15 +1417,51 @@ public:
 		}
 		const FDeformMeshVertexFactory* DeformMeshVertexFactory = ((FDeformMeshVertexFactory*)VertexFactory);
 
-		/* Get the transform index from the vertex factory and pass it as the value for TransformIndex */
+		/* With manual vertex fetch, the streams are read from the SRVs of the LocalVF uniform buffer*/
+		if (DeformMeshVertexFactory->SupportsManualVertexFetch(FeatureLevel) && DeformMeshVertexFactory->GetUniformBuffer())
+		{
+			ShaderBindings.Add(Shader->GetUniformBufferParameter<FLocalVertexFactoryUniformShaderParameters>(), DeformMeshVertexFactory->GetUniformBuffer());
+		}
+
+		/* Get the transform index from the vertex factory, offset by the range of the scene proxy in the transform pool, and pass it as the value for TransformIndex */
 		const uint32 Index = DeformMeshVertexFactory->TransformIndex;
-		ShaderBindings.Add(TransformIndex, Index);
+		ShaderBindings.Add(TransformIndex, DeformMeshVertexFactory->SceneProxy->GetTransformIndex(Index));
 		/* Get tHE SRV from the scen proxy and pass is as the value for TransformsSRV*/
 		ShaderBindings.Add(TransformsSRV, DeformMeshVertexFactory->SceneProxy->GetDeformTransformsSRV());
+		/* The spline of the section is in the same buffer, the shader checks whether the section is in spline mode*/
+		ShaderBindings.Add(SplineIndex, DeformMeshVertexFactory->SceneProxy->GetSplineSlotsIndex(Index));
+
+		/* A section playing a baked animation gets the two frames to blend at the view's world time, that's the only thing that changes while it plays*/
+		const FDeformMeshSectionPlayback* Playback = DeformMeshVertexFactory->Playback;
+		if (Playback && Playback->IsPlaying())
+		{
+			const FDeformMeshAnimationRenderData& Animation = *Playback->RenderData;
+			const float WorldTime = View ? View->Family->CurrentWorldTime : 0.f;
+			uint32 FrameA, FrameB;
+			float Alpha;
+			Animation.GetFramesAtTime((WorldTime - Playback->StartTime) * Playback->PlayRate, Playback->bLoop, FrameA, FrameB, Alpha);
+
+			ShaderBindings.Add(AnimFrames, FUintVector4(FrameA * Animation.NumVertices, FrameB * Animation.NumVertices, FrameA, FrameB));
+			ShaderBindings.Add(AnimParams, FVector2D(Alpha, 1.f));
+			ShaderBindings.Add(AnimOffsetsSRV, Animation.OffsetsBuffer.GetSRV());
+			ShaderBindings.Add(AnimScalesSRV, Animation.ScalesBuffer.GetSRV());
+		}
+		else
+		{
+			ShaderBindings.Add(AnimFrames, FUintVector4(0, 0, 0, 0));
+			ShaderBindings.Add(AnimParams, FVector2D(0.f, 0.f));
+			ShaderBindings.Add(AnimOffsetsSRV, GNullColorVertexBuffer.VertexBufferSRV);
+			ShaderBindings.Add(AnimScalesSRV, GNullColorVertexBuffer.VertexBufferSRV);
+		}
 	};
 private:
 	LAYOUT_FIELD(FShaderParameter, TransformIndex);
 	LAYOUT_FIELD(FShaderResourceParameter, TransformsSRV);
+	LAYOUT_FIELD(FShaderParameter, SplineIndex);
+	LAYOUT_FIELD(FShaderParameter, AnimFrames);
+	LAYOUT_FIELD(FShaderParameter, AnimParams);
+	LAYOUT_FIELD(FShaderResourceParameter, AnimOffsetsSRV);
+	LAYOUT_FIELD(FShaderResourceParameter, AnimScalesSRV);
 
 };
 
@@ -589,7 +1475,8 @@ IMPLEMENT_VERTEX_FACTORY_PARAMETER_TYPE(FDeformMeshVertexFactory, SF_Vertex, FDe
 
 ///////////////////////////////////////////////////////////////////////
 
-IMPLEMENT_VERTEX_FACTORY_TYPE(FDeformMeshVertexFactory, "/CustomShaders/LocalVertexFactory.ush", true, true, true, true, true);
+//The deform mesh is always drawn as a dynamic mesh, it can't have lightmaps, so we don't need the static lighting permutations
+IMPLEMENT_VERTEX_FACTORY_TYPE(FDeformMeshVertexFactory, "/CustomShaders/LocalVertexFactory.ush", true, false, true, true, true);
 
 ///////////////////////////////////////////////////////////////////////
 
@@ -605,27 +1492,45 @@ IMPLEMENT_VERTEX_FACTORY_TYPE(FDeformMeshVertexFactory, "/CustomShaders/LocalVer
 /*
  * Most of ths method below are self explanatory, they make changes to the game thread state and propagate changes to the render thread using the scene proxy
 */
+int32 FDeformMeshSection::GetNumVertices() const
+{
+	if (RenderData.IsValid())
+	{
+		return RenderData->NumVertices;
+	}
+	if (StaticMesh && StaticMesh->RenderData && StaticMesh->RenderData->LODResources.Num() > 0)
+	{
+		return StaticMesh->RenderData->LODResources[0].VertexBuffers.PositionVertexBuffer.GetNumVertices();
+	}
+	return 0;
+}
+
 void UDeformMeshComponent::CreateMeshSection(int32 SectionIndex, UStaticMesh* Mesh, const FTransform& Transform)
 {
+	// A section created directly replaces a section that was being streamed in
+	CancelSectionLoad(SectionIndex);
+
 	// Ensure sections array is long enough
 	if (SectionIndex >= DeformMeshSections.Num())
 	{
-		DeformMeshSections.SetNum(SectionIndex + 1, false);
+		SetNumSections(SectionIndex + 1);
 	}
 
 	// Reset this section (in case it already existed)
+	ResetSection(SectionIndex);
 	FDeformMeshSection& NewSection = DeformMeshSections[SectionIndex];
-	NewSection.Reset();
 
 	// Fill in the mesh section with the needed data
 	// I'm assuming that the StaticMesh has only one section and I'm only using that
 	NewSection.StaticMesh = Mesh;
-	NewSection.DeformTransform = Transform.ToMatrixWithScale().GetTransposed();
+	SectionDeformTransforms[SectionIndex] = Transform.ToMatrixWithScale().GetTransposed();
 
 	//Update the local bound using the bounds of the static mesh that we're adding
 	//I'm not taking in consideration the deformation here, if the deformation cause the mesh to go outside its bounds
 	NewSection.StaticMesh->CalculateExtendedBounds();
-	NewSection.SectionLocalBox += NewSection.StaticMesh->GetBoundingBox();
+	const FBox MeshBox = NewSection.StaticMesh->GetBoundingBox();
+	SectionLocalBoxes[SectionIndex] += MeshBox;
+	SetBoxHullPoints(MeshBox, NewSection.BoundsHullPoints);
 
 	//Add this sections' material to the list of the component's materials, with the same index as the section
 	SetMaterial(SectionIndex, NewSection.StaticMesh->GetMaterial(0));
@@ -636,168 +1541,1212 @@ void UDeformMeshComponent::CreateMeshSection(int32 SectionIndex, UStaticMesh* Me
 }
 
 /// <summary>
-/// Update the Transform Matrix that we use to deform the mesh
-/// The update of the state in the game thread is simple, but for the scene proxy update, we need to enqueue a render command
+/// Create a section from generated geometry
+/// The arrays end up owned by the section's render data, the RHI reads them in place when the buffers are created and they're kept to create the buffers again if needed
 /// </summary>
-/// <param name="SectionIndex"> The index for the section that we want to update its DeformTransform </param>
-/// <param name="Transform"> The new Transform Matrix </param>
-void UDeformMeshComponent::UpdateMeshSectionTransform(int32 SectionIndex, const FTransform& Transform)
+void UDeformMeshComponent::CreateMeshSection(int32 SectionIndex, TArray<FVector>&& Positions, TArray<FVector2D>&& TexCoords, TArray<uint32>&& Indices, const FTransform& Transform)
 {
-	if (SectionIndex < DeformMeshSections.Num())
+	if (SectionIndex < 0)
 	{
-		//Set game thread state
-		const FMatrix TransformMatrix = Transform.ToMatrixWithScale().GetTransposed();
-		DeformMeshSections[SectionIndex].DeformTransform = TransformMatrix;
+		UE_LOG(LogDeformMeshComponent, Warning, TEXT("Section %d of %s can't be created, section indices start at 0"), SectionIndex, *GetPathName());
+		return;
+	}
+	if (Positions.Num() == 0 || Indices.Num() < 3)
+	{
+		UE_LOG(LogDeformMeshComponent, Warning, TEXT("Section %d of %s can't be created without vertices and triangles"), SectionIndex, *GetPathName());
+		return;
+	}
+	if (Indices.Num() % 3 != 0)
+	{
+		UE_LOG(LogDeformMeshComponent, Warning, TEXT("Section %d of %s can't be created from %d indices, it's not a list of triangles"), SectionIndex, *GetPathName(), Indices.Num());
+		return;
+	}
+	//The GPU would read past the vertex buffers
+	for (int32 IndexIdx = 0; IndexIdx < Indices.Num(); IndexIdx++)
+	{
+		if (Indices[IndexIdx] >= (uint32)Positions.Num())
+		{
+			UE_LOG(LogDeformMeshComponent, Warning, TEXT("Section %d of %s can't be created, index %d refers to vertex %u but there are only %d vertices"), SectionIndex, *GetPathName(), IndexIdx, Indices[IndexIdx], Positions.Num());
+			return;
+		}
+	}
 
-		DeformMeshSections[SectionIndex].SectionLocalBox += DeformMeshSections[SectionIndex].StaticMesh->GetBoundingBox().TransformBy(Transform);
+	// A section created directly replaces a section that was being streamed in
+	CancelSectionLoad(SectionIndex);
 
+	// Ensure sections array is long enough
+	if (SectionIndex >= DeformMeshSections.Num())
+	{
+		SetNumSections(SectionIndex + 1);
+	}
 
-		if (SceneProxy)
-		{
-			// Enqueue command to modify render thread info
-			FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
-			ENQUEUE_RENDER_COMMAND(FDeformMeshTransformsUpdate)(
-				[DeformMeshSceneProxy, SectionIndex, TransformMatrix](FRHICommandListImmediate& RHICmdList)
-				{
-					DeformMeshSceneProxy->UpdateDeformTransform_RenderThread(SectionIndex, TransformMatrix);
-				});
-		}
-		UpdateLocalBounds();		 // Update overall bounds
-		MarkRenderTransformDirty();  // Need to send new bounds to render thread
+	// Reset this section (in case it already existed)
+	ResetSection(SectionIndex);
+	FDeformMeshSection& NewSection = DeformMeshSections[SectionIndex];
+
+	//The materials sample the first texture coordinate channel, so a section without one gets zeros
+	if (TexCoords.Num() != Positions.Num())
+	{
+		UE_CLOG(TexCoords.Num() > 0, LogDeformMeshComponent, Warning, TEXT("Section %d of %s has %d texture coordinates for %d vertices, they're ignored"), SectionIndex, *GetPathName(), TexCoords.Num(), Positions.Num());
+		TexCoords.Reset();
+		TexCoords.AddZeroed(Positions.Num());
 	}
+
+	//The bounds are the only thing that needs to read the positions on the CPU
+	const FBox MeshBox(Positions);
+	SectionLocalBoxes[SectionIndex] += MeshBox;
+	SetBoxHullPoints(MeshBox, NewSection.BoundsHullPoints);
+	SectionDeformTransforms[SectionIndex] = Transform.ToMatrixWithScale().GetTransposed();
+
+	FDeformMeshSectionRenderDataPtr RenderData = FDeformMeshSectionRenderData::Create();
+	RenderData->SetGeneratedGeometry(MoveTemp(Positions), MoveTemp(TexCoords), MoveTemp(Indices));
+	RenderData->BeginInitResources();
+	NewSection.RenderData = RenderData;
+
+	UpdateLocalBounds(); // Update overall bounds
+	MarkRenderStateDirty(); // New section requires recreating scene proxy
 }
 
-void UDeformMeshComponent::ClearMeshSection(int32 SectionIndex)
+void UDeformMeshComponent::UpdateMeshSectionPositions(int32 SectionIndex, int32 FirstVertex, TArray<FVector>&& Positions)
 {
-	if (SectionIndex < DeformMeshSections.Num())
+	//The buffers of an asset section are shared by all the components that use the asset, only generated geometry can be rewritten
+	if (!DeformMeshSections.IsValidIndex(SectionIndex) || !DeformMeshSections[SectionIndex].RenderData.IsValid() || DeformMeshSections[SectionIndex].SourceAsset || Positions.Num() == 0)
 	{
-		DeformMeshSections[SectionIndex].Reset();
-		UpdateLocalBounds();
-		MarkRenderStateDirty();
+		return;
+	}
+
+	FDeformMeshSection& Section = DeformMeshSections[SectionIndex];
+	if (FirstVertex < 0 || FirstVertex + Positions.Num() > Section.GetNumVertices())
+	{
+		UE_LOG(LogDeformMeshComponent, Warning, TEXT("Vertices %d to %d are out of section %d of %s, it has %d vertices"),
+			FirstVertex, FirstVertex + Positions.Num() - 1, SectionIndex, *GetPathName(), Section.GetNumVertices());
+		return;
 	}
+
+	//The other positions are only on the GPU, so the bounds can only grow
+	FBox MeshBox(Section.BoundsHullPoints);
+	MeshBox += FBox(Positions);
+	SetBoxHullPoints(MeshBox, Section.BoundsHullPoints);
+	SectionLocalBoxes[SectionIndex] += MeshBox;
+	SectionLocalBoxes[SectionIndex] += Section.CalcDeformedBox(SectionDeformTransforms[SectionIndex].GetTransposed());
+	UpdateLocalBounds(); // Update overall bounds
+
+	//The render data is shared with the scene proxy, so the update doesn't go through it, and the positions are moved into the command
+	FDeformMeshSectionRenderDataPtr RenderData = Section.RenderData;
+	DEFORMMESH_COUNTER_ADD(RenderCommands, 1);
+	ENQUEUE_RENDER_COMMAND(FDeformMeshSectionPositionsUpdate)(
+		[RenderData, FirstVertex, Positions = MoveTemp(Positions)](FRHICommandListImmediate& RHICmdList)
+		{
+			RenderData->UpdatePositions_RenderThread(FirstVertex, Positions);
+		});
 }
 
 /// <summary>
-/// This method is called after we finished updating all the section transforms that we want to update
-/// This will update the structured buffer with the new transforms
+/// Create the sections from the cooked sections of a deform mesh asset
+/// Nothing is computed here, the GPU buffers, the hull points and the default deform parameters all come from the asset
 /// </summary>
-void UDeformMeshComponent::FinishTransformsUpdate()
+void UDeformMeshComponent::CreateMeshSectionsFromAsset(UDeformMeshAsset* Asset, int32 FirstSectionIndex)
 {
-	if (SceneProxy)
+	if (!Asset || Asset->GetNumSections() == 0)
 	{
-		// Enqueue command to modify render thread info
-		FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
-		ENQUEUE_RENDER_COMMAND(FDeformMeshAllTransformsSBUpdate)(
-			[DeformMeshSceneProxy](FRHICommandListImmediate& RHICmdList)
-			{
-				DeformMeshSceneProxy->UpdateDeformTransformsSB_RenderThread();
-			});
+		return;
+	}
+	if (FirstSectionIndex < 0)
+	{
+		UE_LOG(LogDeformMeshComponent, Warning, TEXT("The sections of %s can't be created at %d in %s, section indices start at 0"), *Asset->GetPathName(), FirstSectionIndex, *GetPathName());
+		return;
 	}
-}
 
-void UDeformMeshComponent::ClearAllMeshSections()
-{
-	DeformMeshSections.Empty();
-	UpdateLocalBounds();
-	MarkRenderStateDirty();
-}
+	// Ensure sections array is long enough
+	const int32 NumAssetSections = Asset->GetNumSections();
+	if (FirstSectionIndex + NumAssetSections > DeformMeshSections.Num())
+	{
+		SetNumSections(FirstSectionIndex + NumAssetSections);
+	}
 
-void UDeformMeshComponent::SetMeshSectionVisible(int32 SectionIndex, bool bNewVisibility)
-{
-	if (SectionIndex < DeformMeshSections.Num())
+	for (int32 AssetSectionIdx = 0; AssetSectionIdx < NumAssetSections; AssetSectionIdx++)
 	{
-		// Set game thread state
-		DeformMeshSections[SectionIndex].bSectionVisible = bNewVisibility;
+		const int32 SectionIndex = FirstSectionIndex + AssetSectionIdx;
+		CancelSectionLoad(SectionIndex);
 
-		if (SceneProxy)
-		{
-			// Enqueue command to modify render thread info
-			FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
-			ENQUEUE_RENDER_COMMAND(FDeformMeshSectionVisibilityUpdate)(
-				[DeformMeshSceneProxy, SectionIndex, bNewVisibility](FRHICommandListImmediate& RHICmdList)
-				{
-					DeformMeshSceneProxy->SetSectionVisibility_RenderThread(SectionIndex, bNewVisibility);
-				});
-		}
+		ResetSection(SectionIndex);
+		FDeformMeshSection& NewSection = DeformMeshSections[SectionIndex];
+
+		NewSection.SourceAsset = Asset;
+		NewSection.SourceAssetSectionIndex = AssetSectionIdx;
+		NewSection.RenderData = Asset->GetSectionRenderData(AssetSectionIdx);
+		SectionDeformTransforms[SectionIndex] = Asset->GetSectionDefaultDeformTransform(AssetSectionIdx);
+		NewSection.bSectionVisible = Asset->IsSectionVisibleByDefault(AssetSectionIdx);
+		Asset->GetSectionHullPoints(AssetSectionIdx, NewSection.BoundsHullPoints);
+		SectionLocalBoxes[SectionIndex] += FBox(NewSection.BoundsHullPoints);
+
+		SetMaterial(SectionIndex, Asset->GetSectionMaterial(AssetSectionIdx));
 	}
-}
 
-bool UDeformMeshComponent::IsMeshSectionVisible(int32 SectionIndex) const
-{
-	return (SectionIndex < DeformMeshSections.Num()) ? DeformMeshSections[SectionIndex].bSectionVisible : false;
+	UpdateLocalBounds(); // Update overall bounds
+	MarkRenderStateDirty(); // New sections require recreating scene proxy
 }
 
-int32 UDeformMeshComponent::GetNumSections() const
+void UDeformMeshComponent::RefreshSectionsFromAsset(const UDeformMeshAsset* Asset)
 {
-	return DeformMeshSections.Num();
-}
-
+	if (!Asset || !AcquireAssetRenderData(Asset))
+	{
+		return;
+	}
 
-FDeformMeshSection* UDeformMeshComponent::GetDeformMeshSection(int32 SectionIndex)
-{
-	if (SectionIndex < DeformMeshSections.Num())
+	for (int32 SectionIdx = 0; SectionIdx < DeformMeshSections.Num(); SectionIdx++)
 	{
-		return &DeformMeshSections[SectionIndex];
+		FDeformMeshSection& Section = DeformMeshSections[SectionIdx];
+		if (Section.SourceAsset == Asset)
+		{
+			Asset->GetSectionHullPoints(Section.SourceAssetSectionIndex, Section.BoundsHullPoints);
+			SectionLocalBoxes[SectionIdx] = FBox(Section.BoundsHullPoints) + Section.CalcDeformedBox(SectionDeformTransforms[SectionIdx].GetTransposed());
+		}
 	}
-	else
+	UpdateLocalBounds(); // Update overall bounds
+
+	//Not at the end of the frame, the asset waits for the previous render data to be released before it unlocks the memory that it points to
+	if (IsRenderStateCreated())
 	{
-		return nullptr;
+		RecreateRenderState_Concurrent();
 	}
 }
 
-void UDeformMeshComponent::SetDeformMeshSection(int32 SectionIndex, const FDeformMeshSection& Section)
+/// <summary>
+/// Create a section from a soft reference, the mesh is loaded through the streamable manager, and the section is created in OnSectionMeshLoaded
+/// If the mesh is already loaded, the section is created right away
+/// </summary>
+void UDeformMeshComponent::CreateMeshSectionAsync(int32 SectionIndex, const TSoftObjectPtr<UStaticMesh>& Mesh, const FTransform& Transform)
 {
-	// Ensure sections array is long enough
-	if (SectionIndex >= DeformMeshSections.Num())
+	if (SectionIndex < 0)
+	{
+		UE_LOG(LogDeformMeshComponent, Warning, TEXT("Section %d of %s can't be created, section indices start at 0"), SectionIndex, *GetPathName());
+		return;
+	}
+	if (UStaticMesh* LoadedMesh = Mesh.Get())
 	{
-		DeformMeshSections.SetNum(SectionIndex + 1, false);
+		CreateMeshSection(SectionIndex, LoadedMesh, Transform);
+		return;
 	}
 
-	DeformMeshSections[SectionIndex] = Section;
+	CancelSectionLoad(SectionIndex);
+	if (Mesh.IsNull())
+	{
+		return;
+	}
 
-	UpdateLocalBounds(); // Update overall bounds
-	MarkRenderStateDirty(); // New section requires recreating scene proxy
+	FPendingSectionLoad& PendingLoad = PendingSectionLoads.Add(SectionIndex);
+	PendingLoad.Mesh = Mesh;
+	PendingLoad.DeformTransform = Transform;
+
+	//The priority is only computed when the request is made, the streamable manager doesn't support changing it later
+	const int32 Priority = GetSectionLoadPriority(Transform.GetLocation());
+	TSharedPtr<FStreamableHandle> Handle = UAssetManager::GetStreamableManager().RequestAsyncLoad(
+		Mesh.ToSoftObjectPath(),
+		FStreamableDelegate::CreateUObject(this, &UDeformMeshComponent::OnSectionMeshLoaded, SectionIndex),
+		Priority);
+
+	//The delegate can run inside RequestAsyncLoad, which removes the entry (And may add others), so the reference above can't be used anymore
+	//The handle is only kept if our entry is still waiting for it
+	FPendingSectionLoad* StillPendingLoad = PendingSectionLoads.Find(SectionIndex);
+	if (StillPendingLoad && !StillPendingLoad->Handle.IsValid())
+	{
+		StillPendingLoad->Handle = MoveTemp(Handle);
+	}
 }
 
-FPrimitiveSceneProxy* UDeformMeshComponent::CreateSceneProxy()
+bool UDeformMeshComponent::IsMeshSectionLoading(int32 SectionIndex) const
 {
-	if (!SceneProxy)
-		return new FDeformMeshSceneProxy(this);
-	else
-		return SceneProxy;
+	return PendingSectionLoads.Contains(SectionIndex);
 }
 
-int32 UDeformMeshComponent::GetNumMaterials() const
+void UDeformMeshComponent::OnSectionMeshLoaded(int32 SectionIndex)
 {
-	return DeformMeshSections.Num();
+	FPendingSectionLoad PendingLoad;
+	if (!PendingSectionLoads.RemoveAndCopyValue(SectionIndex, PendingLoad))
+	{
+		//The load was cancelled
+		return;
+	}
+
+	//The delegate can be called before RequestAsyncLoad returns the handle, so we resolve the soft pointer instead of asking the handle
+	UStaticMesh* LoadedMesh = PendingLoad.Mesh.Get();
+	if (LoadedMesh)
+	{
+		CreateMeshSection(SectionIndex, LoadedMesh, PendingLoad.DeformTransform);
+	}
 }
 
+void UDeformMeshComponent::CancelSectionLoad(int32 SectionIndex)
+{
+	FPendingSectionLoad PendingLoad;
+	if (PendingSectionLoads.RemoveAndCopyValue(SectionIndex, PendingLoad) && PendingLoad.Handle.IsValid())
+	{
+		PendingLoad.Handle->CancelHandle();
+	}
+}
 
-//Use this to update the Bounds by taking in consideration the deform transform
-FBoxSphereBounds UDeformMeshComponent::CalcBounds(const FTransform& LocalToWorld) const
+int32 UDeformMeshComponent::GetSectionLoadPriority(const FVector& DeformLocation) const
 {
-	FBoxSphereBounds Ret(LocalBounds.TransformBy(LocalToWorld));
+	//Priorities go from MaxPriority for sections next to a view, down to the default async load priority for far away sections
+	const int32 MaxPriority = 100;
 
-	Ret.BoxExtent *= BoundsScale;
-	Ret.SphereRadius *= BoundsScale;
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return FStreamableManager::DefaultAsyncLoadPriority;
+	}
 
-	return Ret;
+	//Use the views of the last frame if we rendered any, otherwise the camera of the local player
+	float ClosestDistSquared = MAX_flt;
+	for (const FVector& ViewLocation : World->ViewLocationsRenderedLastFrame)
+	{
+		ClosestDistSquared = FMath::Min(ClosestDistSquared, FVector::DistSquared(ViewLocation, DeformLocation));
+	}
+	if (ClosestDistSquared == MAX_flt)
+	{
+		APlayerController* PlayerController = World->GetFirstPlayerController();
+		if (PlayerController && PlayerController->PlayerCameraManager)
+		{
+			ClosestDistSquared = FVector::DistSquared(PlayerController->PlayerCameraManager->GetCameraLocation(), DeformLocation);
+		}
+	}
+	if (ClosestDistSquared == MAX_flt)
+	{
+		return FStreamableManager::DefaultAsyncLoadPriority;
+	}
+
+	const float DistancePerPriority = FMath::Max(1.f, CVarDeformMeshStreamingDistancePerPriority.GetValueOnGameThread());
+	const int32 PriorityDrop = FMath::Min<float>(FMath::Sqrt(ClosestDistSquared) / DistancePerPriority, MaxPriority);
+	return FMath::Max(FStreamableManager::DefaultAsyncLoadPriority, MaxPriority - PriorityDrop);
 }
 
-void UDeformMeshComponent::UpdateLocalBounds()
+/// <summary>
+/// Update the Transform Matrix that we use to deform the mesh
+/// The update of the state in the game thread is simple, but for the scene proxy update, we need to enqueue a render command
+/// </summary>
+/// <param name="SectionIndex"> The index for the section that we want to update its DeformTransform </param>
+/// <param name="Transform"> The new Transform Matrix </param>
+void UDeformMeshComponent::UpdateMeshSectionTransform(int32 SectionIndex, const FTransform& Transform)
 {
-	FBox LocalBox(ForceInit);
+	DEFORMMESH_SCOPED_TIMING(UpdateSectionTransform);
 
-	for (const FDeformMeshSection& Section : DeformMeshSections)
+	//Sections that are still being streamed in just keep their latest transform
+	if (PendingSectionLoads.Num() > 0)
 	{
-		LocalBox += Section.SectionLocalBox;
+		if (FPendingSectionLoad* PendingLoad = PendingSectionLoads.Find(SectionIndex))
+		{
+			PendingLoad->DeformTransform = Transform;
+			return;
+		}
 	}
 
-	LocalBounds = LocalBox.IsValid ? FBoxSphereBounds(LocalBox) : FBoxSphereBounds(FVector(0, 0, 0), FVector(0, 0, 0), 0); // fallback to reset box sphere bounds
+	if (DeformMeshSections.IsValidIndex(SectionIndex) && DeformMeshSections[SectionIndex].HasGeometry())
+	{
+		//Set game thread state
+		const FMatrix TransformMatrix = Transform.ToMatrixWithScale().GetTransposed();
+		SectionDeformTransforms[SectionIndex] = TransformMatrix;
 
-	// Update global bounds
-	UpdateBounds();
-	// Need to send to render thread
-	MarkRenderTransformDirty();
+		if (TransformsRecorder)
+		{
+			FDeformMeshTransformUpdate& Record = RecordedUpdates.AddZeroed_GetRef();
+			Record.SectionIndex = SectionIndex;
+			Record.DeformTransform = TransformMatrix;
+		}
+
+		if (UDeformMeshFieldSubsystem* DeformField = GetDeformField())
+		{
+			DeformField->OnSectionTransformUpdated(this, SectionIndex, TransformMatrix);
+		}
+
+		SectionLocalBoxes[SectionIndex] += DeformMeshSections[SectionIndex].CalcDeformedBox(Transform.ToMatrixWithScale());
+
+
+		if (SceneProxy)
+		{
+			// Enqueue command to modify render thread info
+			FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
+			DEFORMMESH_COUNTER_ADD(RenderCommands, 1);
+			ENQUEUE_RENDER_COMMAND(FDeformMeshTransformsUpdate)(
+				[DeformMeshSceneProxy, SectionIndex, TransformMatrix](FRHICommandListImmediate& RHICmdList)
+				{
+					DeformMeshSceneProxy->UpdateDeformTransform_RenderThread(SectionIndex, TransformMatrix);
+				});
+		}
+		UpdateLocalBounds();		 // Update overall bounds
+		MarkRenderTransformDirty();  // Need to send new bounds to render thread
+	}
+}
+
+/// <summary>
+/// Batched version of UpdateMeshSectionTransform, the game thread state of all the sections is updated first, and then only one render command is enqueued
+/// </summary>
+/// <param name="Updates"> The section indices and their new transform matrices (Already transposed) </param>
+/// <param name="NumUpdates"> Number of updates </param>
+void UDeformMeshComponent::UpdateMeshSectionTransforms(const FDeformMeshTransformUpdate* Updates, int32 NumUpdates)
+{
+	UpdateMeshSectionTransforms_Internal(Updates, NumUpdates, false);
+}
+
+void UDeformMeshComponent::UpdateMeshSectionTransformsInPlace(const FDeformMeshTransformUpdate* Updates, int32 NumUpdates)
+{
+	UpdateMeshSectionTransforms_Internal(Updates, NumUpdates, true);
+}
+
+void UDeformMeshComponent::UpdateMeshSectionTransforms_Internal(const FDeformMeshTransformUpdate* Updates, int32 NumUpdates, bool bUpdatesOutliveRenderCommands)
+{
+	DEFORMMESH_SCOPED_TIMING(UpdateSectionTransform);
+	if (NumUpdates <= 0)
+	{
+		return;
+	}
+
+	//Set game thread state, with the same checks as UpdateMeshSectionTransform()
+	//The updates that are skipped are neither recorded nor sent to the render thread, so both paths record the same stream for the same input
+	//The applied updates are only gathered in their own array once one is skipped, or when the render thread can't read them where they are
+	TArray<FDeformMeshTransformUpdate> AppliedUpdates;
+	bool bGatherAppliedUpdates = !bUpdatesOutliveRenderCommands;
+	if (bGatherAppliedUpdates)
+	{
+		AppliedUpdates.Reserve(NumUpdates);
+	}
+	int32 NumAppliedUpdates = 0;
+	UDeformMeshFieldSubsystem* DeformField = GetDeformField();
+	for (int32 UpdateIdx = 0; UpdateIdx < NumUpdates; UpdateIdx++)
+	{
+		const FDeformMeshTransformUpdate& Update = Updates[UpdateIdx];
+		if (!bGatherAppliedUpdates && NumAppliedUpdates != UpdateIdx)
+		{
+			bGatherAppliedUpdates = true;
+			AppliedUpdates.Append(Updates, NumAppliedUpdates);
+		}
+
+		//Sections that are still being streamed in just keep their latest transform
+		if (PendingSectionLoads.Num() > 0)
+		{
+			if (FPendingSectionLoad* PendingLoad = PendingSectionLoads.Find(Update.SectionIndex))
+			{
+				PendingLoad->DeformTransform = FTransform(Update.DeformTransform.GetTransposed());
+				continue;
+			}
+		}
+
+		if (DeformMeshSections.IsValidIndex(Update.SectionIndex) && DeformMeshSections[Update.SectionIndex].HasGeometry())
+		{
+			SectionDeformTransforms[Update.SectionIndex] = Update.DeformTransform;
+			//The section stores the transposed matrix, so we transpose it back to transform the bounds
+			SectionLocalBoxes[Update.SectionIndex] += DeformMeshSections[Update.SectionIndex].CalcDeformedBox(Update.DeformTransform.GetTransposed());
+
+			NumAppliedUpdates++;
+			if (bGatherAppliedUpdates)
+			{
+				AppliedUpdates.Add(Update);
+			}
+
+			if (TransformsRecorder)
+			{
+				//Zeroed so the padding written to the recording is deterministic
+				FDeformMeshTransformUpdate& Record = RecordedUpdates.AddZeroed_GetRef();
+				Record.SectionIndex = Update.SectionIndex;
+				Record.DeformTransform = Update.DeformTransform;
+			}
+
+			if (DeformField)
+			{
+				DeformField->OnSectionTransformUpdated(this, Update.SectionIndex, Update.DeformTransform);
+			}
+		}
+	}
+
+	if (NumAppliedUpdates == 0)
+	{
+		return;
+	}
+	if (!bGatherAppliedUpdates && NumAppliedUpdates != NumUpdates)
+	{
+		bGatherAppliedUpdates = true;
+		AppliedUpdates.Append(Updates, NumAppliedUpdates);
+	}
+
+	if (SceneProxy)
+	{
+		// Enqueue one command for all the updates
+		FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
+		DEFORMMESH_COUNTER_ADD(RenderCommands, 1);
+		if (bGatherAppliedUpdates)
+		{
+			ENQUEUE_RENDER_COMMAND(FDeformMeshBatchedTransformsUpdate)(
+				[DeformMeshSceneProxy, AppliedUpdates = MoveTemp(AppliedUpdates)](FRHICommandListImmediate& RHICmdList)
+				{
+					DeformMeshSceneProxy->UpdateDeformTransforms_RenderThread(AppliedUpdates.GetData(), AppliedUpdates.Num());
+				});
+		}
+		else
+		{
+			//Every update was applied, the render thread reads them where the caller keeps them
+			ENQUEUE_RENDER_COMMAND(FDeformMeshBatchedTransformsUpdate)(
+				[DeformMeshSceneProxy, Updates, NumUpdates](FRHICommandListImmediate& RHICmdList)
+				{
+					DeformMeshSceneProxy->UpdateDeformTransforms_RenderThread(Updates, NumUpdates);
+				});
+		}
+	}
+	UpdateLocalBounds();		 // Update overall bounds
+	MarkRenderTransformDirty();  // Need to send new bounds to render thread
+}
+
+void UDeformMeshComponent::ClearMeshSection(int32 SectionIndex)
+{
+	CancelSectionLoad(SectionIndex);
+	if (DeformMeshSections.IsValidIndex(SectionIndex))
+	{
+		ResetSection(SectionIndex);
+		UpdateLocalBounds();
+		MarkRenderStateDirty();
+	}
+}
+
+/// <summary>
+/// This method is called after we finished updating all the section transforms that we want to update
+/// This will update the structured buffer with the new transforms
+/// </summary>
+void UDeformMeshComponent::FinishTransformsUpdate()
+{
+	DEFORMMESH_SCOPED_TIMING(FinishTransformsUpdate);
+
+	//Every call is a frame of the recording, even the ones without any update, so the replay keeps the same pacing
+	if (TransformsRecorder)
+	{
+		WriteRecordedFrame();
+	}
+
+	//Nothing to enqueue, the updates are already in the transform pool, which uploads the updates of all the components at once before they're drawn
+}
+
+void UDeformMeshComponent::WriteRecordedFrame()
+{
+	check(TransformsRecorder);
+	FDeformMeshTransformStreamFrame Frame;
+	FMemory::Memzero(Frame);
+	Frame.NumUpdates = RecordedUpdates.Num();
+	TransformsRecorder->Serialize(&Frame, sizeof(Frame));
+	TransformsRecorder->Serialize(RecordedUpdates.GetData(), RecordedUpdates.Num() * sizeof(FDeformMeshTransformUpdate));
+	RecordedUpdates.Reset();
+	NumRecordedFrames++;
+}
+
+bool UDeformMeshComponent::StartRecordingTransforms(const FString& Filename)
+{
+	StopRecordingTransforms();
+
+	TransformsRecorder.Reset(IFileManager::Get().CreateFileWriter(*Filename));
+	if (!TransformsRecorder)
+	{
+		return false;
+	}
+
+	//The frame count is patched when the recording stops
+	FDeformMeshTransformStreamHeader Header;
+	FMemory::Memzero(Header);
+	Header.Magic = FDeformMeshTransformStreamHeader::ExpectedMagic;
+	Header.Version = FDeformMeshTransformStreamHeader::ExpectedVersion;
+	TransformsRecorder->Serialize(&Header, sizeof(Header));
+
+	RecordedUpdates.Reset();
+	NumRecordedFrames = 0;
+	return true;
+}
+
+void UDeformMeshComponent::StopRecordingTransforms()
+{
+	if (TransformsRecorder)
+	{
+		//The updates aren't held back until FinishTransformsUpdate(), they reach the transform pool and the GPU as soon as they're made
+		//So the updates made since the last FinishTransformsUpdate() were rendered too, and they're written as a last frame for the recording to match
+		if (RecordedUpdates.Num() > 0)
+		{
+			WriteRecordedFrame();
+		}
+		TransformsRecorder->Seek(offsetof(FDeformMeshTransformStreamHeader, NumFrames));
+		TransformsRecorder->Serialize(&NumRecordedFrames, sizeof(NumRecordedFrames));
+		TransformsRecorder->Close();
+		TransformsRecorder.Reset();
+	}
+	RecordedUpdates.Empty();
+}
+
+void UDeformMeshComponent::ClearAllMeshSections()
+{
+	TArray<int32> LoadingSections;
+	PendingSectionLoads.GetKeys(LoadingSections);
+	for (int32 SectionIndex : LoadingSections)
+	{
+		CancelSectionLoad(SectionIndex);
+	}
+
+	DeformMeshSections.Empty();
+	SectionDeformTransforms.Empty();
+	SectionLocalBoxes.Empty();
+	MarkSectionsChanged();
+	UpdateLocalBounds();
+	MarkRenderStateDirty();
+}
+
+void UDeformMeshComponent::SetMeshSectionVisible(int32 SectionIndex, bool bNewVisibility)
+{
+	if (DeformMeshSections.IsValidIndex(SectionIndex))
+	{
+		// Set game thread state
+		DeformMeshSections[SectionIndex].bSectionVisible = bNewVisibility;
+
+		if (DeformMeshSections[SectionIndex].FrozenData.IsValid())
+		{
+			//The static batches of the frozen sections are cached by the renderer, they only change with a new scene proxy
+			MarkRenderStateDirty();
+		}
+		else if (SceneProxy)
+		{
+			// Enqueue command to modify render thread info
+			FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
+			DEFORMMESH_COUNTER_ADD(RenderCommands, 1);
+			ENQUEUE_RENDER_COMMAND(FDeformMeshSectionVisibilityUpdate)(
+				[DeformMeshSceneProxy, SectionIndex, bNewVisibility](FRHICommandListImmediate& RHICmdList)
+				{
+					DeformMeshSceneProxy->SetSectionVisibility_RenderThread(SectionIndex, bNewVisibility);
+				});
+		}
+	}
+}
+
+void UDeformMeshComponent::SetMeshSectionsVisibility(const TBitArray<>& Visibility)
+{
+	// Set game thread state
+	const int32 NumSections = FMath::Min(Visibility.Num(), DeformMeshSections.Num());
+	bool bFrozenVisibilityChanged = false;
+	for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+	{
+		FDeformMeshSection& Section = DeformMeshSections[SectionIdx];
+		bFrozenVisibilityChanged |= Section.FrozenData.IsValid() && Section.bSectionVisible != Visibility[SectionIdx];
+		Section.bSectionVisible = Visibility[SectionIdx];
+	}
+
+	//The static batches of the frozen sections are cached by the renderer, they only change with a new scene proxy
+	if (bFrozenVisibilityChanged)
+	{
+		MarkRenderStateDirty();
+	}
+
+	if (SceneProxy && NumSections > 0)
+	{
+		// Enqueue one command for all the sections
+		FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
+		DEFORMMESH_COUNTER_ADD(RenderCommands, 1);
+		ENQUEUE_RENDER_COMMAND(FDeformMeshSectionsVisibilityUpdate)(
+			[DeformMeshSceneProxy, Visibility](FRHICommandListImmediate& RHICmdList)
+			{
+				DeformMeshSceneProxy->SetSectionsVisibility_RenderThread(Visibility);
+			});
+	}
+}
+
+bool UDeformMeshComponent::IsMeshSectionVisible(int32 SectionIndex) const
+{
+	return DeformMeshSections.IsValidIndex(SectionIndex) ? DeformMeshSections[SectionIndex].bSectionVisible : false;
+}
+
+void UDeformMeshComponent::SetMeshSectionCastShadow(int32 SectionIndex, bool bNewCastShadow)
+{
+	if (DeformMeshSections.IsValidIndex(SectionIndex))
+	{
+		// Set game thread state
+		DeformMeshSections[SectionIndex].bCastShadow = bNewCastShadow;
+
+		if (DeformMeshSections[SectionIndex].FrozenData.IsValid())
+		{
+			MarkRenderStateDirty();
+		}
+		else if (SceneProxy)
+		{
+			// Enqueue command to modify render thread info
+			FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
+			DEFORMMESH_COUNTER_ADD(RenderCommands, 1);
+			ENQUEUE_RENDER_COMMAND(FDeformMeshSectionCastShadowUpdate)(
+				[DeformMeshSceneProxy, SectionIndex, bNewCastShadow](FRHICommandListImmediate& RHICmdList)
+				{
+					DeformMeshSceneProxy->SetSectionCastShadow_RenderThread(SectionIndex, bNewCastShadow);
+				});
+		}
+	}
+}
+
+bool UDeformMeshComponent::IsMeshSectionCastingShadow(int32 SectionIndex) const
+{
+	return DeformMeshSections.IsValidIndex(SectionIndex) ? DeformMeshSections[SectionIndex].bCastShadow : false;
+}
+
+void UDeformMeshComponent::SetMeshSectionDeformWeights(int32 SectionIndex, EDeformMeshWeightSource Source, int32 UVChannel)
+{
+	if (DeformMeshSections.IsValidIndex(SectionIndex))
+	{
+		FDeformMeshSection& Section = DeformMeshSections[SectionIndex];
+		if (Section.DeformWeightSource != Source || Section.DeformWeightUVChannel != UVChannel)
+		{
+			Section.DeformWeightSource = Source;
+			Section.DeformWeightUVChannel = UVChannel;
+			MarkRenderStateDirty(); // The weights are bound to the vertex factory when the scene proxy is created
+		}
+	}
+}
+
+EDeformMeshWeightSource UDeformMeshComponent::GetMeshSectionDeformWeightSource(int32 SectionIndex) const
+{
+	return DeformMeshSections.IsValidIndex(SectionIndex) ? DeformMeshSections[SectionIndex].DeformWeightSource : EDeformMeshWeightSource::None;
+}
+
+void UDeformMeshComponent::PlayMeshSectionAnimation(int32 SectionIndex, UDeformMeshAnimation* Animation, float PlayRate, bool bLoop)
+{
+	if (!DeformMeshSections.IsValidIndex(SectionIndex) || !Animation || !Animation->GetRenderData().IsValid())
+	{
+		return;
+	}
+
+	FDeformMeshSection& Section = DeformMeshSections[SectionIndex];
+	if (Section.GetNumVertices() != Animation->GetNumVertices())
+	{
+		UE_LOG(LogDeformMeshComponent, Warning, TEXT("%s was baked from a mesh with %d vertices, section %d of %s has %d"),
+			*Animation->GetPathName(), Animation->GetNumVertices(), SectionIndex, *GetPathName(), Section.GetNumVertices());
+		return;
+	}
+
+	//A frozen section doesn't have a deform section proxy to play the animation on
+	if (Section.FrozenData.IsValid())
+	{
+		Section.FrozenData.Reset();
+		MarkRenderStateDirty();
+	}
+
+	// Set game thread state
+	UWorld* World = GetWorld();
+	Section.Animation = Animation;
+	Section.AnimationStartTime = World ? World->GetTimeSeconds() : 0.f;
+	Section.AnimationPlayRate = PlayRate;
+	Section.bLoopAnimation = bLoop;
+	//The bounds of all the baked frames, so they don't need to follow the animation
+	SectionLocalBoxes[SectionIndex] = Animation->GetBounds();
+
+	if (SceneProxy)
+	{
+		FDeformMeshSectionPlayback Playback;
+		Playback.RenderData = Animation->GetRenderData();
+		Playback.StartTime = Section.AnimationStartTime;
+		Playback.PlayRate = PlayRate;
+		Playback.bLoop = bLoop;
+
+		// Enqueue command to modify render thread info
+		FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
+		DEFORMMESH_COUNTER_ADD(RenderCommands, 1);
+		ENQUEUE_RENDER_COMMAND(FDeformMeshSectionPlaybackUpdate)(
+			[DeformMeshSceneProxy, SectionIndex, Playback](FRHICommandListImmediate& RHICmdList)
+			{
+				DeformMeshSceneProxy->SetSectionPlayback_RenderThread(SectionIndex, Playback);
+			});
+	}
+	UpdateLocalBounds();
+}
+
+void UDeformMeshComponent::StopMeshSectionAnimation(int32 SectionIndex)
+{
+	if (!DeformMeshSections.IsValidIndex(SectionIndex) || !DeformMeshSections[SectionIndex].Animation)
+	{
+		return;
+	}
+
+	// Set game thread state
+	FDeformMeshSection& Section = DeformMeshSections[SectionIndex];
+	Section.Animation = nullptr;
+	SectionLocalBoxes[SectionIndex] = FBox(Section.BoundsHullPoints);
+	SectionLocalBoxes[SectionIndex] += Section.DeformMode == EDeformMeshDeformMode::Spline
+		? CalcSplineDeformedBox(Section)
+		: Section.CalcDeformedBox(SectionDeformTransforms[SectionIndex].GetTransposed());
+
+	if (SceneProxy)
+	{
+		// Enqueue command to modify render thread info
+		FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
+		DEFORMMESH_COUNTER_ADD(RenderCommands, 1);
+		ENQUEUE_RENDER_COMMAND(FDeformMeshSectionPlaybackUpdate)(
+			[DeformMeshSceneProxy, SectionIndex](FRHICommandListImmediate& RHICmdList)
+			{
+				DeformMeshSceneProxy->SetSectionPlayback_RenderThread(SectionIndex, FDeformMeshSectionPlayback());
+			});
+	}
+	UpdateLocalBounds();
+}
+
+bool UDeformMeshComponent::IsMeshSectionPlayingAnimation(int32 SectionIndex) const
+{
+	return DeformMeshSections.IsValidIndex(SectionIndex) ? DeformMeshSections[SectionIndex].Animation != nullptr : false;
+}
+
+void UDeformMeshComponent::SetMeshSectionSplineDeform(int32 SectionIndex, const FSplineMeshParams& SplineParams, ESplineMeshAxis::Type ForwardAxis, const FVector& UpDir)
+{
+	if (DeformMeshSections.IsValidIndex(SectionIndex))
+	{
+		FDeformMeshSection& Section = DeformMeshSections[SectionIndex];
+		Section.DeformMode = EDeformMeshDeformMode::Spline;
+		Section.SplineParams = SplineParams;
+		Section.SplineForwardAxis = ForwardAxis;
+		Section.SplineUpDir = UpDir;
+		UpdateMeshSectionSpline(SectionIndex);
+	}
+}
+
+void UDeformMeshComponent::SetMeshSectionDeformMode(int32 SectionIndex, EDeformMeshDeformMode DeformMode)
+{
+	if (DeformMeshSections.IsValidIndex(SectionIndex) && DeformMeshSections[SectionIndex].DeformMode != DeformMode)
+	{
+		DeformMeshSections[SectionIndex].DeformMode = DeformMode;
+		UpdateMeshSectionSpline(SectionIndex);
+	}
+}
+
+EDeformMeshDeformMode UDeformMeshComponent::GetMeshSectionDeformMode(int32 SectionIndex) const
+{
+	return DeformMeshSections.IsValidIndex(SectionIndex) ? DeformMeshSections[SectionIndex].DeformMode : EDeformMeshDeformMode::Transform;
+}
+
+void UDeformMeshComponent::UpdateMeshSectionSpline(int32 SectionIndex)
+{
+	FDeformMeshSection& Section = DeformMeshSections[SectionIndex];
+
+	// Set game thread state, a section playing a baked animation keeps the bounds of the animation
+	if (!Section.Animation)
+	{
+		SectionLocalBoxes[SectionIndex] = FBox(Section.BoundsHullPoints);
+		SectionLocalBoxes[SectionIndex] += Section.DeformMode == EDeformMeshDeformMode::Spline
+			? CalcSplineDeformedBox(Section)
+			: Section.CalcDeformedBox(SectionDeformTransforms[SectionIndex].GetTransposed());
+	}
+
+	if (SceneProxy)
+	{
+		FMatrix Slots[NumSplineSlots];
+		PackSplineSlots(Section, Slots);
+
+		// Enqueue command to modify render thread info
+		FDeformMeshSceneProxy* DeformMeshSceneProxy = (FDeformMeshSceneProxy*)SceneProxy;
+		DEFORMMESH_COUNTER_ADD(RenderCommands, 1);
+		ENQUEUE_RENDER_COMMAND(FDeformMeshSectionSplineUpdate)(
+			[DeformMeshSceneProxy, SectionIndex, Slots](FRHICommandListImmediate& RHICmdList)
+			{
+				DeformMeshSceneProxy->SetSectionSplineSlots_RenderThread(SectionIndex, Slots);
+			});
+	}
+	UpdateLocalBounds();
+}
+
+bool UDeformMeshComponent::FreezeMeshSection(int32 SectionIndex)
+{
+	if (!DeformMeshSections.IsValidIndex(SectionIndex))
+	{
+		return false;
+	}
+
+	FDeformMeshSection& Section = DeformMeshSections[SectionIndex];
+	if (Section.FrozenData.IsValid())
+	{
+		return true;
+	}
+
+	//The positions of asset sections are only on the GPU, and an animation moves the vertices every frame
+	if (!Section.StaticMesh || !Section.StaticMesh->RenderData || Section.Animation)
+	{
+		UE_LOG(LogDeformMeshComponent, Warning, TEXT("Section %d of %s can't be frozen, only static mesh sections that don't play an animation can"), SectionIndex, *GetPathName());
+		return false;
+	}
+
+	FStaticMeshLODResources& LODResource = Section.StaticMesh->RenderData->LODResources[0];
+	FPositionVertexBuffer& SrcPositions = LODResource.VertexBuffers.PositionVertexBuffer;
+	const int32 NumVertices = SrcPositions.GetNumVertices();
+	if (NumVertices == 0 || !SrcPositions.GetVertexData())
+	{
+		UE_LOG(LogDeformMeshComponent, Warning, TEXT("Section %d of %s can't be frozen, %s doesn't allow CPU access"), SectionIndex, *GetPathName(), *Section.StaticMesh->GetPathName());
+		return false;
+	}
+
+	//The task only works on copies, so the section can be updated or cleared while it runs
+	TArray<FVector> Positions;
+	Positions.SetNumUninitialized(NumVertices);
+	FMemory::Memcpy(Positions.GetData(), SrcPositions.GetVertexData(), NumVertices * sizeof(FVector));
+
+	//Vertices without weights are fully deformed, the same way the shader deforms them
+	TArray<float> Weights;
+	bool bConvertWeights = false;
+	if (GetDeformMeshWeights(LODResource, Section.DeformWeightSource, Section.DeformWeightUVChannel, Weights))
+	{
+		//The vertex colors are bound as they are, only the weights of a texture coordinate channel need a buffer of their own
+		bConvertWeights = Section.DeformWeightSource == EDeformMeshWeightSource::TexCoord;
+	}
+	else
+	{
+		Weights.Init(1.f, NumVertices);
+	}
+
+	const bool bSplineMode = Section.DeformMode == EDeformMeshDeformMode::Spline;
+	TArray<FVector4> SplineParams;
+	SplineParams.SetNumZeroed(FDeformMeshMath::NumSplineParams);
+	if (bSplineMode)
+	{
+		FDeformMeshMath::PackSplineParams(Section.SplineParams, Section.SplineForwardAxis, Section.SplineUpDir, FBox(Section.BoundsHullPoints), SplineParams.GetData());
+	}
+	const FMatrix LocalToWorld = GetComponentTransform().ToMatrixWithScale();
+	const FMatrix WorldToLocal = LocalToWorld.InverseFast();
+	const FMatrix DeformTransform = SectionDeformTransforms[SectionIndex];
+
+	//The render data waits for the task before it's released, so the task doesn't need to keep a reference to it
+	FDeformMeshFrozenRenderDataPtr FrozenData = FDeformMeshFrozenRenderData::Create();
+	FDeformMeshFrozenRenderData* FrozenDataToFill = FrozenData.Get();
+	FrozenData->FreezeTask = FFunctionGraphTask::CreateAndDispatchWhenReady(
+		[FrozenDataToFill, Positions = MoveTemp(Positions), Weights = MoveTemp(Weights), SplineParams = MoveTemp(SplineParams), bSplineMode, bConvertWeights, LocalToWorld, WorldToLocal, DeformTransform]() mutable
+		{
+			DEFORMMESH_SCOPED_TIMING(FreezeSection);
+			for (int32 VertexIdx = 0; VertexIdx < Positions.Num(); VertexIdx++)
+			{
+				const FVector& RestPosition = Positions[VertexIdx];
+				Positions[VertexIdx] = bSplineMode
+					? FMath::Lerp(RestPosition, FDeformMeshMath::CalcSplineDeformedLocalPosition(RestPosition, SplineParams.GetData()), Weights[VertexIdx])
+					: FDeformMeshMath::CalcDeformedLocalPosition(RestPosition, LocalToWorld, WorldToLocal, DeformTransform, Weights[VertexIdx]);
+			}
+			//Only the GPU needs the baked positions
+			FrozenDataToFill->PositionBuffer.Init(Positions, false);
+			if (bConvertWeights)
+			{
+				InitDeformWeightBuffer(Weights, FrozenDataToFill->WeightBuffer);
+			}
+		},
+		TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+
+	//The section switches to its baked positions with the next scene proxy, unless it was unfrozen or cleared in the meantime
+	TWeakObjectPtr<UDeformMeshComponent> WeakThis(this);
+	TWeakPtr<FDeformMeshFrozenRenderData, ESPMode::ThreadSafe> WeakFrozenData(FrozenData);
+	FFunctionGraphTask::CreateAndDispatchWhenReady(
+		[WeakThis, WeakFrozenData]()
+		{
+			if (WeakThis.IsValid() && WeakFrozenData.IsValid())
+			{
+				WeakThis->MarkRenderStateDirty();
+			}
+		},
+		TStatId(), FrozenData->FreezeTask, ENamedThreads::GameThread);
+
+	Section.FrozenData = FrozenData;
+	return true;
+}
+
+void UDeformMeshComponent::UnfreezeMeshSection(int32 SectionIndex)
+{
+	if (DeformMeshSections.IsValidIndex(SectionIndex) && DeformMeshSections[SectionIndex].FrozenData.IsValid())
+	{
+		DeformMeshSections[SectionIndex].FrozenData.Reset();
+		MarkRenderStateDirty(); // The section needs its deform section proxy back
+	}
+}
+
+bool UDeformMeshComponent::IsMeshSectionFrozen(int32 SectionIndex) const
+{
+	return DeformMeshSections.IsValidIndex(SectionIndex) ? DeformMeshSections[SectionIndex].FrozenData.IsValid() : false;
+}
+
+void UDeformMeshComponent::SetShadowLODBias(int32 NewShadowLODBias)
+{
+	NewShadowLODBias = FMath::Max(0, NewShadowLODBias);
+	if (ShadowLODBias != NewShadowLODBias)
+	{
+		ShadowLODBias = NewShadowLODBias;
+		MarkRenderStateDirty(); // The shadow LOD resources are created with the scene proxy
+	}
+}
+
+int32 UDeformMeshComponent::GetNumSections() const
+{
+	return DeformMeshSections.Num();
+}
+
+
+FDeformMeshSection* UDeformMeshComponent::GetDeformMeshSection(int32 SectionIndex)
+{
+	if (DeformMeshSections.IsValidIndex(SectionIndex))
+	{
+		return &DeformMeshSections[SectionIndex];
+	}
+	else
+	{
+		return nullptr;
+	}
+}
+
+void UDeformMeshComponent::SetDeformMeshSection(int32 SectionIndex, const FDeformMeshSection& Section)
+{
+	// Ensure sections array is long enough
+	if (SectionIndex >= DeformMeshSections.Num())
+	{
+		SetNumSections(SectionIndex + 1);
+	}
+
+	DeformMeshSections[SectionIndex] = Section;
+	MarkSectionsChanged();
+	DeformMeshSections[SectionIndex].Revision = SectionsRevision;
+	SectionLocalBoxes[SectionIndex] = FBox(Section.BoundsHullPoints) + Section.CalcDeformedBox(SectionDeformTransforms[SectionIndex].GetTransposed());
+
+	UpdateLocalBounds(); // Update overall bounds
+	MarkRenderStateDirty(); // New section requires recreating scene proxy
+}
+
+FMatrix UDeformMeshComponent::GetMeshSectionDeformMatrix(int32 SectionIndex) const
+{
+	return (SectionIndex < SectionDeformTransforms.Num()) ? SectionDeformTransforms[SectionIndex].GetTransposed() : FMatrix::Identity;
+}
+
+FPrimitiveSceneProxy* UDeformMeshComponent::CreateSceneProxy()
+{
+	if (!SceneProxy)
+	{
+		DEFORMMESH_COUNTER_ADD(ProxyRebuilds, 1);
+		return new FDeformMeshSceneProxy(this);
+	}
+	else
+	{
+		return SceneProxy;
+	}
+}
+
+int32 UDeformMeshComponent::GetNumMaterials() const
+{
+	return DeformMeshSections.Num();
+}
+
+
+void UDeformMeshComponent::OnComponentDestroyed(bool bDestroyingHierarchy)
+{
+	StopRecordingTransforms();
+	for (TPair<int32, FPendingSectionLoad>& PendingLoad : PendingSectionLoads)
+	{
+		if (PendingLoad.Value.Handle.IsValid())
+		{
+			PendingLoad.Value.Handle->CancelHandle();
+		}
+	}
+	PendingSectionLoads.Empty();
+	Super::OnComponentDestroyed(bDestroyingHierarchy);
+}
+
+void UDeformMeshComponent::Serialize(FArchive& Ar)
+{
+	Ar.UsingCustomVersion(FDeformMeshCustomVersion::GUID);
+	Super::Serialize(Ar);
+}
+
+void UDeformMeshComponent::PostLoad()
+{
+	Super::PostLoad();
+
+	//Components saved before the per frame data moved out of the sections have it in the deprecated section properties
+	if (GetLinkerCustomVersion(FDeformMeshCustomVersion::GUID) < FDeformMeshCustomVersion::SectionDataInParallelArrays &&
+		SectionDeformTransforms.Num() != DeformMeshSections.Num())
+	{
+		SetNumSections(DeformMeshSections.Num());
+		for (int32 SectionIdx = 0; SectionIdx < DeformMeshSections.Num(); SectionIdx++)
+		{
+			SectionDeformTransforms[SectionIdx] = DeformMeshSections[SectionIdx].DeformTransform_DEPRECATED;
+			SectionLocalBoxes[SectionIdx] = DeformMeshSections[SectionIdx].SectionLocalBox_DEPRECATED;
+		}
+	}
+	else if (SectionDeformTransforms.Num() != DeformMeshSections.Num() || SectionLocalBoxes.Num() != DeformMeshSections.Num())
+	{
+		SetNumSections(DeformMeshSections.Num());
+	}
+
+	//A section whose box wasn't saved would be left out of the bounds, and culled, so its box is rebuilt from its hull points
+	bool bRebuiltBoxes = false;
+	for (int32 SectionIdx = 0; SectionIdx < DeformMeshSections.Num(); SectionIdx++)
+	{
+		const FDeformMeshSection& Section = DeformMeshSections[SectionIdx];
+		if (!SectionLocalBoxes[SectionIdx].IsValid && Section.BoundsHullPoints.Num() > 0)
+		{
+			SectionLocalBoxes[SectionIdx] = FBox(Section.BoundsHullPoints);
+			SectionLocalBoxes[SectionIdx] += Section.DeformMode == EDeformMeshDeformMode::Spline
+				? CalcSplineDeformedBox(Section)
+				: Section.CalcDeformedBox(SectionDeformTransforms[SectionIdx].GetTransposed());
+			bRebuiltBoxes = true;
+		}
+	}
+	if (bRebuiltBoxes)
+	{
+		UpdateLocalBounds();
+	}
+
+	//The render data of the asset sections isn't saved, the assets create it in their own PostLoad
+	for (FDeformMeshSection& Section : DeformMeshSections)
+	{
+		if (Section.SourceAsset)
+		{
+			Section.SourceAsset->ConditionalPostLoad();
+		}
+	}
+	AcquireAssetRenderData();
+}
+
+void UDeformMeshComponent::OnRegister()
+{
+	//Duplicated components (PIE, copy paste) don't go through PostLoad, so the asset render data is picked up again before the scene proxy is created
+	AcquireAssetRenderData();
+	Super::OnRegister();
+	if (bAffectedByDeformField)
+	{
+		if (UDeformMeshFieldSubsystem* DeformField = UDeformMeshFieldSubsystem::Get(GetWorld()))
+		{
+			DeformField->RegisterComponent(this);
+		}
+	}
+}
+
+void UDeformMeshComponent::OnUnregister()
+{
+	//Before the scene proxy is destroyed, so the sections get their transforms back
+	if (UDeformMeshFieldSubsystem* DeformField = UDeformMeshFieldSubsystem::Get(GetWorld()))
+	{
+		DeformField->UnregisterComponent(this);
+	}
+	Super::OnUnregister();
+}
+
+void UDeformMeshComponent::SetAffectedByDeformField(bool bNewAffectedByDeformField)
+{
+	if (bAffectedByDeformField != bNewAffectedByDeformField)
+	{
+		bAffectedByDeformField = bNewAffectedByDeformField;
+		if (IsRegistered())
+		{
+			if (UDeformMeshFieldSubsystem* DeformField = UDeformMeshFieldSubsystem::Get(GetWorld()))
+			{
+				if (bAffectedByDeformField)
+				{
+					DeformField->RegisterComponent(this);
+				}
+				else
+				{
+					DeformField->UnregisterComponent(this);
+				}
+			}
+		}
+	}
+}
+
+bool UDeformMeshComponent::AcquireAssetRenderData(const UDeformMeshAsset* Asset)
+{
+	bool bChanged = false;
+	for (FDeformMeshSection& Section : DeformMeshSections)
+	{
+		if (Section.SourceAsset && (!Asset || Section.SourceAsset == Asset))
+		{
+			TSharedPtr<FDeformMeshSectionRenderData, ESPMode::ThreadSafe> RenderData = Section.SourceAsset->GetSectionRenderData(Section.SourceAssetSectionIndex);
+			if (RenderData != Section.RenderData)
+			{
+				Section.RenderData = MoveTemp(RenderData);
+				bChanged = true;
+			}
+		}
+	}
+
+	if (bChanged)
+	{
+		MarkSectionsChanged();
+	}
+	return bChanged;
+}
+
+//Use this to update the Bounds by taking in consideration the deform transform
+FBoxSphereBounds UDeformMeshComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	FBoxSphereBounds Ret(LocalBounds.TransformBy(LocalToWorld));
+
+	Ret.BoxExtent *= BoundsScale;
+	Ret.SphereRadius *= BoundsScale;
+
+	return Ret;
+}
+
+void UDeformMeshComponent::OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	Super::OnUpdateTransform(UpdateTransformFlags, Teleport);
+	if (UDeformMeshFieldSubsystem* DeformField = GetDeformField())
+	{
+		DeformField->MarkComponentDirty(this);
+	}
+}
+
+void UDeformMeshComponent::UpdateLocalBounds()
+{
+	FBox LocalBox(ForceInit);
+
+	for (const FBox& SectionLocalBox : SectionLocalBoxes)
+	{
+		LocalBox += SectionLocalBox;
+	}
+
+	LocalBounds = LocalBox.IsValid ? FBoxSphereBounds(LocalBox) : FBoxSphereBounds(FVector(0, 0, 0), FVector(0, 0, 0), 0); // fallback to reset box sphere bounds
+
+	// Update global bounds
+	UpdateBounds();
+	// Need to send to render thread
+	MarkRenderTransformDirty();
+}
+
+void UDeformMeshComponent::SetNumSections(int32 NumSections)
+{
+	const int32 OldNumSections = DeformMeshSections.Num();
+	DeformMeshSections.SetNum(NumSections, false);
+	MarkSectionsChanged();
+	for (int32 SectionIdx = OldNumSections; SectionIdx < NumSections; SectionIdx++)
+	{
+		DeformMeshSections[SectionIdx].Revision = SectionsRevision;
+	}
+
+	//Neither FMatrix nor FBox initialize themselves, so the new entries are set here
+	const int32 OldNumTransforms = SectionDeformTransforms.Num();
+	SectionDeformTransforms.SetNumUninitialized(NumSections, false);
+	for (int32 SectionIdx = OldNumTransforms; SectionIdx < NumSections; SectionIdx++)
+	{
+		SectionDeformTransforms[SectionIdx] = FMatrix::Identity;
+	}
+
+	const int32 OldNumBoxes = SectionLocalBoxes.Num();
+	SectionLocalBoxes.SetNumUninitialized(NumSections, false);
+	for (int32 SectionIdx = OldNumBoxes; SectionIdx < NumSections; SectionIdx++)
+	{
+		SectionLocalBoxes[SectionIdx].Init();
+	}
+}
+
+void UDeformMeshComponent::MarkSectionsChanged()
+{
+	SectionsRevision++;
+	if (UDeformMeshFieldSubsystem* DeformField = GetDeformField())
+	{
+		DeformField->MarkComponentDirty(this);
+	}
+}
+
+UDeformMeshFieldSubsystem* UDeformMeshComponent::GetDeformField() const
+{
+	return bAffectedByDeformField && IsRegistered() ? UDeformMeshFieldSubsystem::Get(GetWorld()) : nullptr;
+}
+
+void UDeformMeshComponent::ResetSection(int32 SectionIndex)
+{
+	DeformMeshSections[SectionIndex].Reset();
+	SectionLocalBoxes[SectionIndex].Init();
+	MarkSectionsChanged();
+	DeformMeshSections[SectionIndex].Revision = SectionsRevision;
 }
 
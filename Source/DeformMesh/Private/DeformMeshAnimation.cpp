@@ -0,0 +1,173 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "DeformMeshAnimation.h"
+#include "DeformMeshRenderData.h"
+#include "DeformMeshMath.h"
+#include "DeformMeshTransformReplay.h"
+#include "RenderingThread.h"
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogDeformMeshAnimation, Log, All);
+
+UDeformMeshAnimation::UDeformMeshAnimation()
+	: FrameRate(30.f)
+	, NumVertices(0)
+	, Bounds(ForceInit)
+{
+#if WITH_EDITORONLY_DATA
+	SourceMesh = nullptr;
+	SourceSectionIndex = 0;
+	WeightSource = EDeformMeshWeightSource::None;
+	WeightUVChannel = 0;
+#endif
+}
+
+void UDeformMeshAnimation::PostLoad()
+{
+	Super::PostLoad();
+	if (!HasAnyFlags(RF_ClassDefaultObject))
+	{
+		InitResources();
+	}
+}
+
+void UDeformMeshAnimation::BeginDestroy()
+{
+	Super::BeginDestroy();
+
+	//The buffers read our arrays when they're initialized on the render thread, the fence tells us when that's done
+	RenderData.Reset();
+	ReleaseFence.BeginFence();
+}
+
+bool UDeformMeshAnimation::IsReadyForFinishDestroy()
+{
+	return Super::IsReadyForFinishDestroy() && ReleaseFence.IsFenceComplete();
+}
+
+void UDeformMeshAnimation::InitResources()
+{
+	check(!RenderData.IsValid());
+	const int32 NumFrames = FrameScales.Num();
+	if (NumVertices <= 0 || NumFrames <= 0 || QuantizedOffsets.Num() != NumVertices * NumFrames * 4)
+	{
+		return;
+	}
+
+	RenderData = FDeformMeshAnimationRenderData::Create();
+	RenderData->NumVertices = NumVertices;
+	RenderData->NumFrames = NumFrames;
+	RenderData->FrameRate = FrameRate;
+
+	//The shader always reads these as Buffer<>, whether manual vertex fetch is supported or not
+	RenderData->OffsetsBuffer.SetSource(new FDeformMeshResourceArrayView(QuantizedOffsets.GetData(), QuantizedOffsets.Num() * sizeof(int16)), 4 * sizeof(int16), PF_R16G16B16A16_SNORM, true);
+	RenderData->ScalesBuffer.SetSource(new FDeformMeshResourceArrayView(FrameScales.GetData(), FrameScales.Num() * sizeof(float)), sizeof(float), PF_R32_FLOAT, true);
+	RenderData->BeginInitResources();
+}
+
+
+#if WITH_EDITOR
+
+void UDeformMeshAnimation::Bake()
+{
+	if (!SourceMesh)
+	{
+		UE_LOG(LogDeformMeshAnimation, Warning, TEXT("%s doesn't have a source mesh"), *GetPathName());
+		return;
+	}
+
+	FDeformMeshTransformReplay Replay;
+	if (!Replay.Open(TransformStream.FilePath))
+	{
+		return;
+	}
+
+	//Frames that don't update the section keep its previous transform, the same way the component does
+	TArray<FMatrix> DeformTrack;
+	DeformTrack.Reserve(Replay.GetNumFrames());
+	FMatrix DeformTransform = InitialDeformTransform.ToMatrixWithScale().GetTransposed();
+	for (int32 FrameIdx = 0; FrameIdx < Replay.GetNumFrames(); FrameIdx++)
+	{
+		const FDeformMeshTransformUpdate* Updates;
+		int32 NumUpdates;
+		Replay.GetCurrentFrameUpdates(Updates, NumUpdates);
+		for (int32 UpdateIdx = 0; UpdateIdx < NumUpdates; UpdateIdx++)
+		{
+			if (Updates[UpdateIdx].SectionIndex == SourceSectionIndex)
+			{
+				DeformTransform = Updates[UpdateIdx].DeformTransform;
+			}
+		}
+		DeformTrack.Add(DeformTransform);
+		Replay.AdvanceFrame();
+	}
+
+	BakeTrack(SourceMesh, ComponentTransform, DeformTrack, WeightSource, WeightUVChannel);
+}
+
+bool UDeformMeshAnimation::BakeTrack(UStaticMesh* Mesh, const FTransform& LocalToWorld, const TArray<FMatrix>& DeformTrack, EDeformMeshWeightSource InWeightSource, int32 InWeightUVChannel)
+{
+	if (!Mesh || !Mesh->RenderData || Mesh->RenderData->LODResources.Num() == 0 || DeformTrack.Num() == 0)
+	{
+		UE_LOG(LogDeformMeshAnimation, Warning, TEXT("%s can't be baked without a mesh with render data and at least one frame"), *GetPathName());
+		return false;
+	}
+
+	//The render data reads our arrays, so it must be gone before they're rewritten
+	RenderData.Reset();
+	FlushRenderingCommands();
+
+	const FStaticMeshLODResources& LODResource = Mesh->RenderData->LODResources[0];
+	const FPositionVertexBuffer& Positions = LODResource.VertexBuffers.PositionVertexBuffer;
+	const FMatrix LocalToWorldMatrix = LocalToWorld.ToMatrixWithScale();
+	const FMatrix WorldToLocalMatrix = LocalToWorldMatrix.InverseFast();
+	const int32 NumFrames = DeformTrack.Num();
+
+	NumVertices = Positions.GetNumVertices();
+
+	//Vertices without weights are fully deformed, the same way the component renders them
+	TArray<float> Weights;
+	if (!GetDeformMeshWeights(LODResource, InWeightSource, InWeightUVChannel, Weights))
+	{
+		Weights.Init(1.f, NumVertices);
+	}
+	QuantizedOffsets.SetNumUninitialized(NumVertices * NumFrames * 4);
+	FrameScales.SetNumUninitialized(NumFrames);
+	Bounds.Init();
+
+	TArray<FVector> FrameOffsets;
+	FrameOffsets.SetNumUninitialized(NumVertices);
+	for (int32 FrameIdx = 0; FrameIdx < NumFrames; FrameIdx++)
+	{
+		//Deform every vertex with the same math as the shader, and keep the offset from its rest position
+		float MaxComponent = 0.f;
+		for (int32 VertexIdx = 0; VertexIdx < NumVertices; VertexIdx++)
+		{
+			const FVector& RestPosition = Positions.VertexPosition(VertexIdx);
+			const FVector DeformedPosition = FDeformMeshMath::CalcDeformedLocalPosition(RestPosition, LocalToWorldMatrix, WorldToLocalMatrix, DeformTrack[FrameIdx], Weights[VertexIdx]);
+			FrameOffsets[VertexIdx] = DeformedPosition - RestPosition;
+			MaxComponent = FMath::Max(MaxComponent, FrameOffsets[VertexIdx].GetAbsMax());
+			Bounds += DeformedPosition;
+		}
+
+		//Each frame is quantized on its own range, so small motions keep their precision next to big ones
+		const float Scale = FMath::Max(MaxComponent, KINDA_SMALL_NUMBER);
+		FrameScales[FrameIdx] = Scale;
+		int16* FrameQuantizedOffsets = QuantizedOffsets.GetData() + FrameIdx * NumVertices * 4;
+		for (int32 VertexIdx = 0; VertexIdx < NumVertices; VertexIdx++)
+		{
+			const FVector Normalized = FrameOffsets[VertexIdx] / Scale;
+			FrameQuantizedOffsets[VertexIdx * 4 + 0] = (int16)FMath::RoundToInt(FMath::Clamp(Normalized.X, -1.f, 1.f) * MAX_int16);
+			FrameQuantizedOffsets[VertexIdx * 4 + 1] = (int16)FMath::RoundToInt(FMath::Clamp(Normalized.Y, -1.f, 1.f) * MAX_int16);
+			FrameQuantizedOffsets[VertexIdx * 4 + 2] = (int16)FMath::RoundToInt(FMath::Clamp(Normalized.Z, -1.f, 1.f) * MAX_int16);
+			FrameQuantizedOffsets[VertexIdx * 4 + 3] = 0;
+		}
+	}
+
+	InitResources();
+	MarkPackageDirty();
+	return true;
+}
+
+#endif
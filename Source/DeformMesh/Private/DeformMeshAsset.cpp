@@ -0,0 +1,331 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "DeformMeshAsset.h"
+#include "DeformMeshRenderData.h"
+#include "RenderingThread.h"
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
+#include "Materials/MaterialInterface.h"
+#include "Components/DeformMeshComponent.h"
+#include "UObject/UObjectIterator.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogDeformMeshAsset, Log, All);
+
+UDeformMeshAsset::UDeformMeshAsset()
+	: LockedBlob(nullptr)
+	, BlobSections(nullptr)
+{
+}
+
+TSharedPtr<FDeformMeshSectionRenderData, ESPMode::ThreadSafe> UDeformMeshAsset::GetSectionRenderData(int32 SectionIndex) const
+{
+	return SectionRenderData.IsValidIndex(SectionIndex) ? SectionRenderData[SectionIndex] : nullptr;
+}
+
+FMatrix UDeformMeshAsset::GetSectionDefaultDeformTransform(int32 SectionIndex) const
+{
+	FMatrix Result = FMatrix::Identity;
+	if (BlobSections && SectionRenderData.IsValidIndex(SectionIndex))
+	{
+		FMemory::Memcpy(Result.M, BlobSections[SectionIndex].DefaultDeformTransform, sizeof(Result.M));
+	}
+	return Result;
+}
+
+bool UDeformMeshAsset::IsSectionVisibleByDefault(int32 SectionIndex) const
+{
+	return BlobSections && SectionRenderData.IsValidIndex(SectionIndex) ? BlobSections[SectionIndex].bVisible != 0 : false;
+}
+
+void UDeformMeshAsset::GetSectionHullPoints(int32 SectionIndex, TArray<FVector>& OutHullPoints) const
+{
+	OutHullPoints.Reset();
+	if (BlobSections && SectionRenderData.IsValidIndex(SectionIndex))
+	{
+		const FDeformMeshAssetBlobSection& Section = BlobSections[SectionIndex];
+		OutHullPoints.Append(reinterpret_cast<const FVector*>(LockedBlob + Section.HullPointsOffset), Section.NumHullPoints);
+	}
+}
+
+UMaterialInterface* UDeformMeshAsset::GetSectionMaterial(int32 SectionIndex) const
+{
+	return Materials.IsValidIndex(SectionIndex) ? Materials[SectionIndex] : nullptr;
+}
+
+void UDeformMeshAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	//When cooking, the payload goes to its own file, aligned so it can be memory mapped when it's loaded
+	if (Ar.IsCooking())
+	{
+		BulkData.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload | BULKDATA_MemoryMappedPayload);
+	}
+	else
+	{
+		BulkData.ClearBulkDataFlags(BULKDATA_Force_NOT_InlinePayload | BULKDATA_MemoryMappedPayload);
+	}
+	BulkData.Serialize(Ar, this);
+}
+
+void UDeformMeshAsset::PostLoad()
+{
+	Super::PostLoad();
+	if (!HasAnyFlags(RF_ClassDefaultObject))
+	{
+		InitResources();
+	}
+}
+
+void UDeformMeshAsset::BeginDestroy()
+{
+	Super::BeginDestroy();
+
+	//The render data is released on the render thread when its last reference goes away, the fence tells us when that's done
+	SectionRenderData.Empty();
+	ReleaseFence.BeginFence();
+}
+
+bool UDeformMeshAsset::IsReadyForFinishDestroy()
+{
+	return Super::IsReadyForFinishDestroy() && ReleaseFence.IsFenceComplete();
+}
+
+void UDeformMeshAsset::FinishDestroy()
+{
+	UnlockBlob();
+	Super::FinishDestroy();
+}
+
+void UDeformMeshAsset::InitResources()
+{
+	check(!LockedBlob);
+	if (BulkData.GetBulkDataSize() < (int64)sizeof(FDeformMeshAssetBlobHeader))
+	{
+		return;
+	}
+
+	//In cooked builds this is the memory mapped payload, nothing is read or copied until the RHI creates the buffers from it
+	LockedBlob = static_cast<const uint8*>(BulkData.LockReadOnly());
+	const FDeformMeshAssetBlobHeader* Header = reinterpret_cast<const FDeformMeshAssetBlobHeader*>(LockedBlob);
+	if (Header->Magic != FDeformMeshAssetBlobHeader::ExpectedMagic || Header->Version != FDeformMeshAssetBlobHeader::ExpectedVersion)
+	{
+		UE_LOG(LogDeformMeshAsset, Warning, TEXT("%s was cooked with another version, it needs to be rebuilt"), *GetPathName());
+		UnlockBlob();
+		return;
+	}
+
+	BlobSections = reinterpret_cast<const FDeformMeshAssetBlobSection*>(LockedBlob + sizeof(FDeformMeshAssetBlobHeader));
+	SectionRenderData.Reset(Header->NumSections);
+	for (uint32 SectionIdx = 0; SectionIdx < Header->NumSections; SectionIdx++)
+	{
+		const FDeformMeshAssetBlobSection& Section = BlobSections[SectionIdx];
+		TSharedPtr<FDeformMeshSectionRenderData, ESPMode::ThreadSafe> RenderData;
+		if (Section.NumVertices > 0 && Section.NumIndices > 0)
+		{
+			RenderData = FDeformMeshSectionRenderData::Create();
+			RenderData->NumVertices = Section.NumVertices;
+			RenderData->NumTexCoords = Section.NumTexCoords;
+			RenderData->bFullPrecisionUVs = false;
+
+			//The buffers point directly to the streams in the blob
+			const uint32 TexCoordStride = Section.NumTexCoords * sizeof(FVector2DHalf);
+			RenderData->PositionBuffer.SetSource(new FDeformMeshResourceArrayView(LockedBlob + Section.PositionsOffset, Section.NumVertices * sizeof(FVector)), sizeof(FVector), PF_R32_FLOAT);
+			RenderData->TexCoordBuffer.SetSource(new FDeformMeshResourceArrayView(LockedBlob + Section.TexCoordsOffset, Section.NumVertices * TexCoordStride), TexCoordStride, PF_G16R16F);
+			RenderData->IndexBuffer.SetSource(new FDeformMeshResourceArrayView(LockedBlob + Section.IndicesOffset, Section.NumIndices * Section.IndexStride), Section.IndexStride);
+			RenderData->BeginInitResources();
+		}
+		SectionRenderData.Add(RenderData);
+	}
+}
+
+bool UDeformMeshAsset::ReleaseResources(const TArray<UDeformMeshComponent*>& Users)
+{
+	TArray<TSharedPtr<FDeformMeshSectionRenderData, ESPMode::ThreadSafe>> ReleasedRenderData = MoveTemp(SectionRenderData);
+	SectionRenderData.Reset();
+	for (UDeformMeshComponent* User : Users)
+	{
+		User->RefreshSectionsFromAsset(this);
+	}
+
+	//Once the previous scene proxies are deleted, our references should be the last ones
+	FlushRenderingCommands();
+	for (const TSharedPtr<FDeformMeshSectionRenderData, ESPMode::ThreadSafe>& RenderData : ReleasedRenderData)
+	{
+		if (RenderData.IsValid() && !RenderData.IsUnique())
+		{
+			SectionRenderData = MoveTemp(ReleasedRenderData);
+			for (UDeformMeshComponent* User : Users)
+			{
+				User->RefreshSectionsFromAsset(this);
+			}
+			return false;
+		}
+	}
+
+	//The buffers read the blob when they're initialized (And again if the RHI recreates them), so they must be released before we unlock it
+	ReleasedRenderData.Empty();
+	FlushRenderingCommands();
+	UnlockBlob();
+	return true;
+}
+
+void UDeformMeshAsset::UnlockBlob()
+{
+	if (LockedBlob)
+	{
+		BulkData.Unlock();
+		LockedBlob = nullptr;
+		BlobSections = nullptr;
+	}
+}
+
+
+#if WITH_EDITOR
+
+/* Append a stream to the blob, 16 bytes aligned, and return its offset*/
+static uint32 AppendBlobStream(TArray<uint8>& Blob, const void* Data, uint32 DataSize)
+{
+	const uint32 Offset = Align(Blob.Num(), 16);
+	Blob.SetNumZeroed(Offset + DataSize);
+	if (DataSize > 0)
+	{
+		FMemory::Memcpy(Blob.GetData() + Offset, Data, DataSize);
+	}
+	return Offset;
+}
+
+/* Keep the 8 corners of the box of all the vertices, the same hull that static mesh sections use*/
+/* Every vertex is inside their convex hull, so the box of the transformed corners always contains the transformed vertices*/
+static void ComputeHullPoints(const FPositionVertexBuffer& Positions, TArray<FVector>& OutHullPoints)
+{
+	FBox Box(ForceInit);
+	for (uint32 VertexIdx = 0; VertexIdx < Positions.GetNumVertices(); VertexIdx++)
+	{
+		Box += Positions.VertexPosition(VertexIdx);
+	}
+
+	OutHullPoints.Reset(8);
+	for (int32 Corner = 0; Corner < 8; Corner++)
+	{
+		OutHullPoints.Add(FVector(
+			(Corner & 1) ? Box.Max.X : Box.Min.X,
+			(Corner & 2) ? Box.Max.Y : Box.Min.Y,
+			(Corner & 4) ? Box.Max.Z : Box.Min.Z));
+	}
+}
+
+void UDeformMeshAsset::Build()
+{
+	TArray<UDeformMeshComponent*> Users;
+	for (TObjectIterator<UDeformMeshComponent> It; It; ++It)
+	{
+		Users.Add(*It);
+	}
+
+	if (!ReleaseResources(Users))
+	{
+		UE_LOG(LogDeformMeshAsset, Error, TEXT("The render data of %s is still in use, it can't be rebuilt now"), *GetPathName());
+		return;
+	}
+
+	const int32 NumSections = SourceSections.Num();
+
+	//Reserve the header and the section table, they're filled at the end when all the offsets are known
+	TArray<uint8> Blob;
+	Blob.SetNumZeroed(sizeof(FDeformMeshAssetBlobHeader) + NumSections * sizeof(FDeformMeshAssetBlobSection));
+	TArray<FDeformMeshAssetBlobSection> Sections;
+	Sections.AddZeroed(NumSections);
+
+	Materials.Reset(NumSections);
+	for (int32 SectionIdx = 0; SectionIdx < NumSections; SectionIdx++)
+	{
+		const FDeformMeshAssetSourceSection& Source = SourceSections[SectionIdx];
+		FDeformMeshAssetBlobSection& Section = Sections[SectionIdx];
+
+		const FMatrix DeformTransform = Source.DefaultDeformTransform.ToMatrixWithScale().GetTransposed();
+		FMemory::Memcpy(Section.DefaultDeformTransform, DeformTransform.M, sizeof(DeformTransform.M));
+		Section.bVisible = Source.bVisible;
+		Materials.Add(Source.StaticMesh ? Source.StaticMesh->GetMaterial(0) : nullptr);
+
+		if (!Source.StaticMesh || !Source.StaticMesh->RenderData || Source.StaticMesh->RenderData->LODResources.Num() == 0)
+		{
+			UE_LOG(LogDeformMeshAsset, Warning, TEXT("Section %d of %s doesn't have a static mesh with render data, it's cooked empty"), SectionIdx, *GetPathName());
+			continue;
+		}
+
+		//We're assuming that there's only one LOD, the same way the component does
+		const FStaticMeshLODResources& LODResource = Source.StaticMesh->RenderData->LODResources[0];
+		const FPositionVertexBuffer& Positions = LODResource.VertexBuffers.PositionVertexBuffer;
+		const FStaticMeshVertexBuffer& StaticMeshVertexBuffer = LODResource.VertexBuffers.StaticMeshVertexBuffer;
+		Section.NumVertices = Positions.GetNumVertices();
+		Section.NumTexCoords = StaticMeshVertexBuffer.GetNumTexCoords();
+
+		TArray<FVector> PositionStream;
+		PositionStream.SetNumUninitialized(Section.NumVertices);
+		for (uint32 VertexIdx = 0; VertexIdx < Section.NumVertices; VertexIdx++)
+		{
+			PositionStream[VertexIdx] = Positions.VertexPosition(VertexIdx);
+		}
+		Section.PositionsOffset = AppendBlobStream(Blob, PositionStream.GetData(), PositionStream.Num() * sizeof(FVector));
+
+		//Interleaved per vertex, the layout that the packed texcoord stream components expect
+		TArray<FVector2DHalf> TexCoordStream;
+		TexCoordStream.Reserve(Section.NumVertices * Section.NumTexCoords);
+		for (uint32 VertexIdx = 0; VertexIdx < Section.NumVertices; VertexIdx++)
+		{
+			for (uint32 UVIndex = 0; UVIndex < Section.NumTexCoords; UVIndex++)
+			{
+				TexCoordStream.Add(FVector2DHalf(StaticMeshVertexBuffer.GetVertexUV(VertexIdx, UVIndex)));
+			}
+		}
+		Section.TexCoordsOffset = AppendBlobStream(Blob, TexCoordStream.GetData(), TexCoordStream.Num() * sizeof(FVector2DHalf));
+
+		//Use the narrowest indices that can address all the vertices
+		TArray<uint32> Indices;
+		LODResource.IndexBuffer.GetCopy(Indices);
+		Section.NumIndices = Indices.Num();
+		if (Section.NumVertices <= MAX_uint16 + 1)
+		{
+			Section.IndexStride = sizeof(uint16);
+			TArray<uint16> NarrowIndices;
+			NarrowIndices.SetNumUninitialized(Indices.Num());
+			for (int32 Index = 0; Index < Indices.Num(); Index++)
+			{
+				NarrowIndices[Index] = (uint16)Indices[Index];
+			}
+			Section.IndicesOffset = AppendBlobStream(Blob, NarrowIndices.GetData(), NarrowIndices.Num() * sizeof(uint16));
+		}
+		else
+		{
+			Section.IndexStride = sizeof(uint32);
+			Section.IndicesOffset = AppendBlobStream(Blob, Indices.GetData(), Indices.Num() * sizeof(uint32));
+		}
+
+		TArray<FVector> HullPoints;
+		ComputeHullPoints(Positions, HullPoints);
+		Section.NumHullPoints = HullPoints.Num();
+		Section.HullPointsOffset = AppendBlobStream(Blob, HullPoints.GetData(), HullPoints.Num() * sizeof(FVector));
+	}
+
+	FDeformMeshAssetBlobHeader Header;
+	FMemory::Memzero(Header);
+	Header.Magic = FDeformMeshAssetBlobHeader::ExpectedMagic;
+	Header.Version = FDeformMeshAssetBlobHeader::ExpectedVersion;
+	Header.NumSections = NumSections;
+	FMemory::Memcpy(Blob.GetData(), &Header, sizeof(Header));
+	FMemory::Memcpy(Blob.GetData() + sizeof(Header), Sections.GetData(), Sections.Num() * sizeof(FDeformMeshAssetBlobSection));
+
+	BulkData.Lock(LOCK_READ_WRITE);
+	FMemory::Memcpy(BulkData.Realloc(Blob.Num()), Blob.GetData(), Blob.Num());
+	BulkData.Unlock();
+
+	InitResources();
+	for (UDeformMeshComponent* User : Users)
+	{
+		User->RefreshSectionsFromAsset(this);
+	}
+	MarkPackageDirty();
+}
+
+#endif
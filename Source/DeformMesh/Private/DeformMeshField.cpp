@@ -0,0 +1,366 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "DeformMeshField.h"
+#include "DeformMeshSettings.h"
+#include "DeformMeshStats.h"
+#include "Components/DeformMeshComponent.h"
+#include "Engine/World.h"
+
+UDeformMeshFieldSubsystem* UDeformMeshFieldSubsystem::Get(const UWorld* World)
+{
+	return World ? World->GetSubsystem<UDeformMeshFieldSubsystem>() : nullptr;
+}
+
+void UDeformMeshFieldSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+	//The cell size is read once, changing it would need to rebuild the whole hash
+	CellSize = FMath::Max(1.f, GetDefault<UDeformMeshSettings>()->DeformFieldCellSize);
+}
+
+void UDeformMeshFieldSubsystem::Deinitialize()
+{
+	Deformers.Empty();
+	Entries.Empty();
+	OversizedEntries.Empty();
+	Components.Empty();
+	DirtyComponents.Empty();
+	AffectedSections.Empty();
+	Super::Deinitialize();
+}
+
+int32 UDeformMeshFieldSubsystem::AddDeformer(const FTransform& Transform, float Radius)
+{
+	FDeformMeshFieldDeformer Deformer;
+	Deformer.Transform = Transform;
+	Deformer.Radius = FMath::Max(0.f, Radius);
+	Deformer.bDirty = true;
+	return Deformers.Add(Deformer);
+}
+
+void UDeformMeshFieldSubsystem::UpdateDeformer(int32 DeformerId, const FTransform& Transform, float Radius)
+{
+	if (Deformers.IsValidIndex(DeformerId))
+	{
+		FDeformMeshFieldDeformer& Deformer = Deformers[DeformerId];
+		Deformer.Transform = Transform;
+		Deformer.Radius = FMath::Max(0.f, Radius);
+		Deformer.bDirty = true;
+	}
+}
+
+void UDeformMeshFieldSubsystem::RemoveDeformer(int32 DeformerId)
+{
+	if (Deformers.IsValidIndex(DeformerId))
+	{
+		Deformers.RemoveAt(DeformerId);
+	}
+}
+
+void UDeformMeshFieldSubsystem::RegisterComponent(UDeformMeshComponent* Component)
+{
+	if (Component && !Components.Contains(Component))
+	{
+		FDeformMeshFieldComponent& Record = Components.Add(Component);
+		RebuildComponentEntries(Component, Record);
+	}
+}
+
+void UDeformMeshFieldSubsystem::UnregisterComponent(UDeformMeshComponent* Component)
+{
+	if (FDeformMeshFieldComponent* Record = Components.Find(Component))
+	{
+		ReleaseComponentSections(Component);
+		RemoveComponentEntries(Component, *Record);
+		Components.Remove(Component);
+		DirtyComponents.Remove(Component);
+	}
+}
+
+void UDeformMeshFieldSubsystem::MarkComponentDirty(UDeformMeshComponent* Component)
+{
+	if (Components.Contains(Component))
+	{
+		DirtyComponents.Add(Component);
+	}
+}
+
+void UDeformMeshFieldSubsystem::OnSectionTransformUpdated(UDeformMeshComponent* Component, int32 SectionIndex, const FMatrix& DeformTransform)
+{
+	if (bPushingTransforms || AffectedSections.Num() == 0)
+	{
+		return;
+	}
+
+	//The section gets the deformer's transform again on the next tick, and this one when it leaves the deformers
+	if (FDeformMeshFieldSection* Affected = AffectedSections.Find(TPair<UDeformMeshComponent*, int32>(Component, SectionIndex)))
+	{
+		Affected->RestTransform = DeformTransform;
+		Affected->DeformerId = INDEX_NONE;
+	}
+}
+
+void UDeformMeshFieldSubsystem::PushSectionTransforms(UDeformMeshComponent* Component, const TArray<FDeformMeshTransformUpdate>& Updates)
+{
+	TGuardValue<bool> PushingTransformsGuard(bPushingTransforms, true);
+	Component->UpdateMeshSectionTransforms(Updates.GetData(), Updates.Num());
+	Component->FinishTransformsUpdate();
+}
+
+bool UDeformMeshFieldSubsystem::IsTickable() const
+{
+	//Once the last deformer is removed, we still need one tick to restore the sections that it affected
+	return !IsTemplate() && (Deformers.Num() > 0 || AffectedSections.Num() > 0);
+}
+
+TStatId UDeformMeshFieldSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDeformMeshFieldSubsystem, STATGROUP_Tickables);
+}
+
+FIntVector UDeformMeshFieldSubsystem::GetCell(const FVector& Position) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Position.X / CellSize),
+		FMath::FloorToInt(Position.Y / CellSize),
+		FMath::FloorToInt(Position.Z / CellSize));
+}
+
+bool UDeformMeshFieldSubsystem::IsCellSpanBounded(const FIntVector& MinCell, const FIntVector& MaxCell)
+{
+	//In 64 bits, the cells of a huge box can be far enough apart to overflow the difference
+	return (int64)MaxCell.X - MinCell.X < MaxCellSpan &&
+		(int64)MaxCell.Y - MinCell.Y < MaxCellSpan &&
+		(int64)MaxCell.Z - MinCell.Z < MaxCellSpan;
+}
+
+void UDeformMeshFieldSubsystem::RebuildComponentEntries(UDeformMeshComponent* Component, FDeformMeshFieldComponent& Record)
+{
+	RemoveComponentEntries(Component, Record);
+	Record.Transform = Component->GetComponentTransform();
+	Record.SectionsRevision = Component->SectionsRevision;
+
+	for (int32 SectionIdx = 0; SectionIdx < Component->DeformMeshSections.Num(); SectionIdx++)
+	{
+		const FDeformMeshSection& Section = Component->DeformMeshSections[SectionIdx];
+		if (!Section.HasGeometry() || Section.BoundsHullPoints.Num() == 0)
+		{
+			continue;
+		}
+
+		FDeformMeshFieldEntry Entry;
+		Entry.Component = Component;
+		Entry.SectionIndex = SectionIdx;
+		Entry.WorldBox = FBox(Section.BoundsHullPoints).TransformBy(Record.Transform);
+
+		const FIntVector MinCell = GetCell(Entry.WorldBox.Min);
+		const FIntVector MaxCell = GetCell(Entry.WorldBox.Max);
+		if (!IsCellSpanBounded(MinCell, MaxCell))
+		{
+			OversizedEntries.Add(Entry);
+			Record.bHasOversizedEntries = true;
+			continue;
+		}
+
+		for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+		{
+			for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+			{
+				for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+				{
+					const FIntVector Cell(X, Y, Z);
+					Entries.Add(Cell, Entry);
+					Record.Cells.Add(Cell);
+				}
+			}
+		}
+	}
+}
+
+void UDeformMeshFieldSubsystem::RemoveComponentEntries(UDeformMeshComponent* Component, FDeformMeshFieldComponent& Record)
+{
+	for (const FIntVector& Cell : Record.Cells)
+	{
+		for (TMultiMap<FIntVector, FDeformMeshFieldEntry>::TKeyIterator It = Entries.CreateKeyIterator(Cell); It; ++It)
+		{
+			if (It.Value().Component == Component)
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+	Record.Cells.Reset();
+
+	if (Record.bHasOversizedEntries)
+	{
+		OversizedEntries.RemoveAllSwap([Component](const FDeformMeshFieldEntry& Entry) { return Entry.Component == Component; });
+		Record.bHasOversizedEntries = false;
+	}
+}
+
+void UDeformMeshFieldSubsystem::ReleaseComponentSections(UDeformMeshComponent* Component)
+{
+	TArray<FDeformMeshTransformUpdate> Updates;
+	for (TMap<TPair<UDeformMeshComponent*, int32>, FDeformMeshFieldSection>::TIterator It = AffectedSections.CreateIterator(); It; ++It)
+	{
+		if (It.Key().Key == Component)
+		{
+			FDeformMeshTransformUpdate& Update = Updates.AddZeroed_GetRef();
+			Update.SectionIndex = It.Key().Value;
+			Update.DeformTransform = It.Value().RestTransform;
+			It.RemoveCurrent();
+		}
+	}
+
+	if (Updates.Num() > 0)
+	{
+		PushSectionTransforms(Component, Updates);
+	}
+}
+
+void UDeformMeshFieldSubsystem::ForgetReplacedSections(UDeformMeshComponent* Component)
+{
+	for (TMap<TPair<UDeformMeshComponent*, int32>, FDeformMeshFieldSection>::TIterator It = AffectedSections.CreateIterator(); It; ++It)
+	{
+		if (It.Key().Key == Component)
+		{
+			const int32 SectionIndex = It.Key().Value;
+			if (!Component->DeformMeshSections.IsValidIndex(SectionIndex) || Component->DeformMeshSections[SectionIndex].Revision != It.Value().SectionRevision)
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+}
+
+void UDeformMeshFieldSubsystem::Tick(float DeltaTime)
+{
+	//The dirty components are kept until there's a deformer again
+	if (Deformers.Num() == 0 && AffectedSections.Num() == 0)
+	{
+		return;
+	}
+	DEFORMMESH_SCOPED_TIMING(UpdateDeformField);
+
+	//Rebuild the entries of the components that moved or whose sections changed, the other components aren't visited
+	//Sections that were cleared or replaced come with their own transforms, so the field forgets them without restoring them, the other sections are still restored when they leave the deformers
+	for (UDeformMeshComponent* Component : DirtyComponents)
+	{
+		FDeformMeshFieldComponent& Record = Components.FindChecked(Component);
+		const bool bSectionsChanged = Record.SectionsRevision != Component->SectionsRevision;
+		if (bSectionsChanged || !Record.Transform.Equals(Component->GetComponentTransform(), 0.f))
+		{
+			if (bSectionsChanged)
+			{
+				ForgetReplacedSections(Component);
+			}
+			RebuildComponentEntries(Component, Record);
+		}
+	}
+	DirtyComponents.Reset();
+
+	//Find the closest deformer of each section within the radius of at least one deformer, only the cells that the deformers overlap are visited
+	//A section in several cells is tested once per cell, which doesn't change its closest deformer
+	typedef TPair<UDeformMeshComponent*, int32> FSectionKey;
+	TMap<FSectionKey, TPair<int32, float>> Assignments;
+	for (TSparseArray<FDeformMeshFieldDeformer>::TConstIterator DeformerIt(Deformers); DeformerIt; ++DeformerIt)
+	{
+		const FDeformMeshFieldDeformer& Deformer = *DeformerIt;
+		const FVector Origin = Deformer.Transform.GetLocation();
+		const float RadiusSquared = FMath::Square(Deformer.Radius);
+
+		auto TestEntry = [&](const FDeformMeshFieldEntry& Entry)
+		{
+			const float DistanceSquared = Entry.WorldBox.ComputeSquaredDistanceToPoint(Origin);
+			if (DistanceSquared <= RadiusSquared)
+			{
+				const FSectionKey Key(Entry.Component, Entry.SectionIndex);
+				const TPair<int32, float>* Assignment = Assignments.Find(Key);
+				if (!Assignment || DistanceSquared < Assignment->Value)
+				{
+					Assignments.Add(Key, TPair<int32, float>(DeformerIt.GetIndex(), DistanceSquared));
+				}
+			}
+		};
+
+		const FIntVector MinCell = GetCell(Origin - FVector(Deformer.Radius));
+		const FIntVector MaxCell = GetCell(Origin + FVector(Deformer.Radius));
+		if (IsCellSpanBounded(MinCell, MaxCell))
+		{
+			for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+			{
+				for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+				{
+					for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+					{
+						for (TMultiMap<FIntVector, FDeformMeshFieldEntry>::TConstKeyIterator EntryIt = Entries.CreateConstKeyIterator(FIntVector(X, Y, Z)); EntryIt; ++EntryIt)
+						{
+							TestEntry(EntryIt.Value());
+						}
+					}
+				}
+			}
+		}
+		else
+		{
+			//A deformer larger than the hash is cheaper to test against every entry than to walk its cells
+			for (const TPair<FIntVector, FDeformMeshFieldEntry>& CellEntry : Entries)
+			{
+				TestEntry(CellEntry.Value);
+			}
+		}
+
+		for (const FDeformMeshFieldEntry& Entry : OversizedEntries)
+		{
+			TestEntry(Entry);
+		}
+	}
+
+	//Only the sections whose deformer changed, or whose deformer moved, get an update
+	TMap<UDeformMeshComponent*, TArray<FDeformMeshTransformUpdate>> Updates;
+	for (const TPair<FSectionKey, TPair<int32, float>>& Assignment : Assignments)
+	{
+		const FSectionKey& Key = Assignment.Key;
+		const int32 DeformerId = Assignment.Value.Key;
+
+		FDeformMeshFieldSection* Affected = AffectedSections.Find(Key);
+		if (!Affected)
+		{
+			Affected = &AffectedSections.Add(Key);
+			Affected->RestTransform = Key.Key->SectionDeformTransforms[Key.Value];
+			Affected->DeformerId = INDEX_NONE;
+			Affected->SectionRevision = Key.Key->DeformMeshSections[Key.Value].Revision;
+		}
+
+		if (Affected->DeformerId != DeformerId || Deformers[DeformerId].bDirty)
+		{
+			Affected->DeformerId = DeformerId;
+			FDeformMeshTransformUpdate& Update = Updates.FindOrAdd(Key.Key).AddZeroed_GetRef();
+			Update.SectionIndex = Key.Value;
+			Update.DeformTransform = Deformers[DeformerId].Transform.ToMatrixWithScale().GetTransposed();
+		}
+	}
+
+	//The sections that left the radius of every deformer get their transforms back
+	for (TMap<FSectionKey, FDeformMeshFieldSection>::TIterator It = AffectedSections.CreateIterator(); It; ++It)
+	{
+		if (!Assignments.Contains(It.Key()))
+		{
+			FDeformMeshTransformUpdate& Update = Updates.FindOrAdd(It.Key().Key).AddZeroed_GetRef();
+			Update.SectionIndex = It.Key().Value;
+			Update.DeformTransform = It.Value().RestTransform;
+			It.RemoveCurrent();
+		}
+	}
+
+	for (FDeformMeshFieldDeformer& Deformer : Deformers)
+	{
+		Deformer.bDirty = false;
+	}
+
+	//One batched update per component
+	for (TPair<UDeformMeshComponent*, TArray<FDeformMeshTransformUpdate>>& Pair : Updates)
+	{
+		PushSectionTransforms(Pair.Key, Pair.Value);
+	}
+}
@@ -0,0 +1,118 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "DeformMeshPSOWarmup.h"
+#include "DeformMeshSettings.h"
+#include "Components/DeformMeshComponent.h"
+#include "Materials/MaterialInterface.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "HAL/IConsoleManager.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogDeformMeshWarmup, Log, All);
+
+ADeformMeshPSOWarmup::ADeformMeshPSOWarmup()
+	: RemainingFrames(0)
+{
+	PrimaryActorTick.bCanEverTick = true;
+	SetActorEnableCollision(false);
+
+	DeformMeshComponent = CreateDefaultSubobject<UDeformMeshComponent>(TEXT("DeformMeshComponent"));
+	RootComponent = DeformMeshComponent;
+}
+
+ADeformMeshPSOWarmup* ADeformMeshPSOWarmup::StartWarmup(UWorld* World, int32 NumFrames)
+{
+	if (!World)
+	{
+		return nullptr;
+	}
+
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParameters.ObjectFlags |= RF_Transient;
+	ADeformMeshPSOWarmup* Warmup = World->SpawnActor<ADeformMeshPSOWarmup>(SpawnParameters);
+	if (Warmup && NumFrames > 0)
+	{
+		Warmup->RemainingFrames = NumFrames;
+	}
+	return Warmup;
+}
+
+void ADeformMeshPSOWarmup::OnWorldInitializedActors(const UWorld::FActorsInitializedParams& Params)
+{
+	const UDeformMeshSettings* Settings = GetDefault<UDeformMeshSettings>();
+	if (Params.World && Params.World->IsGameWorld() && Settings->bWarmupPSOsOnBeginPlay && Settings->AllowedMaterials.Num() > 0)
+	{
+		StartWarmup(Params.World);
+	}
+}
+
+void ADeformMeshPSOWarmup::BeginPlay()
+{
+	Super::BeginPlay();
+
+	const UDeformMeshSettings* Settings = GetDefault<UDeformMeshSettings>();
+	if (RemainingFrames <= 0)
+	{
+		RemainingFrames = FMath::Max(1, Settings->WarmupFrames);
+	}
+
+	//One section per allowed material, the mesh doesn't matter since the pipeline states only depend on the material and the vertex factory
+	UStaticMesh* WarmupMesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	int32 NumSections = 0;
+	for (const TSoftObjectPtr<UMaterialInterface>& AllowedMaterial : Settings->AllowedMaterials)
+	{
+		UMaterialInterface* Material = AllowedMaterial.LoadSynchronous();
+		if (Material && WarmupMesh)
+		{
+			DeformMeshComponent->CreateMeshSection(NumSections, WarmupMesh, FTransform::Identity);
+			DeformMeshComponent->SetMaterial(NumSections, Material);
+			NumSections++;
+		}
+	}
+
+	UE_LOG(LogDeformMeshWarmup, Log, TEXT("Warming up the pipeline states of %d deform mesh materials for %d frames"), NumSections, RemainingFrames);
+	if (NumSections == 0)
+	{
+		Destroy();
+		return;
+	}
+	FollowCamera();
+}
+
+void ADeformMeshPSOWarmup::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (--RemainingFrames <= 0)
+	{
+		Destroy();
+		return;
+	}
+	FollowCamera();
+}
+
+void ADeformMeshPSOWarmup::FollowCamera()
+{
+	UWorld* World = GetWorld();
+	APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+	if (PlayerController && PlayerController->PlayerCameraManager)
+	{
+		//Small enough to be invisible, but still drawn in all the passes
+		const FVector CameraLocation = PlayerController->PlayerCameraManager->GetCameraLocation();
+		const FRotator CameraRotation = PlayerController->PlayerCameraManager->GetCameraRotation();
+		SetActorTransform(FTransform(CameraRotation, CameraLocation + CameraRotation.Vector() * 50.f, FVector(0.001f)));
+	}
+}
+
+
+static void WarmupDeformMeshPSOs(const TArray<FString>& Args, UWorld* World)
+{
+	const int32 NumFrames = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 0;
+	ADeformMeshPSOWarmup::StartWarmup(World, NumFrames);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GDeformMeshWarmupPSOsCommand(
+	TEXT("DeformMesh.WarmupPSOs"),
+	TEXT("[Frames]. Draws every material allowed in the deform mesh settings on a deform mesh for a few frames, so their pipeline states are created (and recorded with -logPSO)."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&WarmupDeformMeshPSOs));
@@ -0,0 +1,405 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderResource.h"
+#include "RHI.h"
+#include "Containers/ResourceArray.h"
+#include "LocalVertexFactory.h"
+#include "RenderUtils.h"
+#include "Rendering/PositionVertexBuffer.h"
+#include "Async/TaskGraphInterfaces.h"
+
+struct FStaticMeshLODResources;
+enum class EDeformMeshWeightSource : uint8;
+
+/* Read the deform weights of a static mesh LOD (0 to 1, one per vertex), returns false if the LOD doesn't have the channel that they're read from*/
+/* The weights are read from the CPU copy of the vertex buffers*/
+bool GetDeformMeshWeights(const FStaticMeshLODResources& LODResource, EDeformMeshWeightSource Source, int32 UVChannel, TArray<float>& OutWeights);
+
+///////////////////////////////////////////////////////////////////////
+// Resource arrays
+/*
+ * The RHI creates a buffer from whatever FResourceArrayInterface we give it in the create info, and calls Discard() when it's done reading it
+ * So instead of copying our data into a TResourceArray, we hand the RHI the memory where the data already is
+*/
+///////////////////////////////////////////////////////////////////////
+
+/* Points to memory owned by someone else (For example the memory mapped payload of a deform mesh asset), the RHI reads it in place */
+class FDeformMeshResourceArrayView : public FResourceArrayInterface
+{
+public:
+	FDeformMeshResourceArrayView(const void* InData, uint32 InDataSize)
+		: Data(InData)
+		, DataSize(InDataSize)
+	{}
+
+	virtual const void* GetResourceData() const override { return Data; }
+	virtual uint32 GetResourceDataSize() const override { return DataSize; }
+	virtual void Discard() override {}
+	virtual bool IsStatic() const override { return true; }
+	virtual bool GetAllowCPUAccess() const override { return false; }
+	virtual void SetAllowCPUAccess(bool bInNeedsCPUAccess) override {}
+
+private:
+	const void* Data;
+	uint32 DataSize;
+};
+
+
+///////////////////////////////////////////////////////////////////////
+// Raw vertex and index buffers
+/*
+ * Vertex and index buffers that are created directly from a resource array, without any conversion
+ * Unlike FPositionVertexBuffer or FRawStaticIndexBuffer, they don't keep their own CPU copy of the data
+*/
+///////////////////////////////////////////////////////////////////////
+class FDeformMeshVertexBuffer : public FVertexBuffer
+{
+public:
+	/* The buffer takes ownership of the resource array, the data it points to must stay valid as long as the buffer since it's read again when the RHI resources are recreated*/
+	/* The SRV format is the format of one element as the manual vertex fetch shaders read it (For example PF_R32_FLOAT for positions, which are read one float at a time)*/
+	/* The SRV is only created for manual vertex fetch, unless the buffer is always read as a Buffer<> by the shader (bInAlwaysCreateSRV)*/
+	void SetSource(FResourceArrayInterface* InSource, uint32 InStride, EPixelFormat InSRVFormat, bool bInAlwaysCreateSRV = false)
+	{
+		Source.Reset(InSource);
+		Stride = InStride;
+		SRVFormat = InSRVFormat;
+		bAlwaysCreateSRV = bInAlwaysCreateSRV;
+	}
+
+	uint32 GetStride() const { return Stride; }
+
+	FRHIShaderResourceView* GetSRV() const { return SRV; }
+
+	virtual void InitRHI() override
+	{
+		if (Source.IsValid() && Source->GetResourceData() != nullptr && Source->GetResourceDataSize() > 0)
+		{
+			FRHIResourceCreateInfo CreateInfo(Source.Get());
+			CreateInfo.DebugName = TEXT("DeformMesh_VertexBuffer");
+			VertexBufferRHI = RHICreateVertexBuffer(Source->GetResourceDataSize(), BUF_Static | BUF_ShaderResource, CreateInfo);
+
+			if (bAlwaysCreateSRV || RHISupportsManualVertexFetch(GMaxRHIShaderPlatform))
+			{
+				SRV = RHICreateShaderResourceView(VertexBufferRHI, GPixelFormats[SRVFormat].BlockBytes, SRVFormat);
+			}
+		}
+	}
+
+	virtual void ReleaseRHI() override
+	{
+		SRV.SafeRelease();
+		FVertexBuffer::ReleaseRHI();
+	}
+
+	virtual FString GetFriendlyName() const override { return TEXT("FDeformMeshVertexBuffer"); }
+
+private:
+	TUniquePtr<FResourceArrayInterface> Source;
+	uint32 Stride = 0;
+	EPixelFormat SRVFormat = PF_R32_FLOAT;
+	bool bAlwaysCreateSRV = false;
+	FShaderResourceViewRHIRef SRV;
+};
+
+class FDeformMeshIndexBuffer : public FIndexBuffer
+{
+public:
+	/* The buffer takes ownership of the resource array, the data it points to must stay valid as long as the buffer*/
+	void SetSource(FResourceArrayInterface* InSource, uint32 InStride)
+	{
+		check(InStride == sizeof(uint16) || InStride == sizeof(uint32));
+		Source.Reset(InSource);
+		Stride = InStride;
+		NumIndices = Source.IsValid() ? Source->GetResourceDataSize() / Stride : 0;
+	}
+
+	/* Counted when the source is set*/
+	uint32 GetNumIndices() const { return NumIndices; }
+
+	virtual void InitRHI() override
+	{
+		if (Source.IsValid() && Source->GetResourceData() != nullptr && Source->GetResourceDataSize() > 0)
+		{
+			FRHIResourceCreateInfo CreateInfo(Source.Get());
+			CreateInfo.DebugName = TEXT("DeformMesh_IndexBuffer");
+			IndexBufferRHI = RHICreateIndexBuffer(Stride, Source->GetResourceDataSize(), BUF_Static, CreateInfo);
+		}
+	}
+
+	virtual FString GetFriendlyName() const override { return TEXT("FDeformMeshIndexBuffer"); }
+
+private:
+	TUniquePtr<FResourceArrayInterface> Source;
+	uint32 Stride = sizeof(uint16);
+	uint32 NumIndices = 0;
+};
+
+
+/* Wrap a new render data in a shared pointer that releases its render resources on the render thread, and deletes it there, when the last reference goes away*/
+template<typename RenderDataType>
+TSharedPtr<RenderDataType, ESPMode::ThreadSafe> MakeRenderThreadReleasedPtr(RenderDataType* RenderData)
+{
+	return TSharedPtr<RenderDataType, ESPMode::ThreadSafe>(RenderData,
+		[](RenderDataType* RenderDataToRelease)
+		{
+			if (IsInRenderingThread())
+			{
+				RenderDataToRelease->ReleaseResources_RenderThread();
+				delete RenderDataToRelease;
+			}
+			else
+			{
+				ENQUEUE_RENDER_COMMAND(ReleaseDeformMeshRenderData)(
+					[RenderDataToRelease](FRHICommandListImmediate& RHICmdList)
+					{
+						RenderDataToRelease->ReleaseResources_RenderThread();
+						delete RenderDataToRelease;
+					});
+			}
+		});
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// The Deform Mesh Section Render Data
+/*
+ * The GPU geometry of a section that doesn't come from a UStaticMesh, either a section of a deform mesh asset or generated geometry
+ * It's shared by every scene proxy that draws the section, so it outlives proxy rebuilds, and is released on the render thread when the last reference goes away
+*/
+///////////////////////////////////////////////////////////////////////
+class FDeformMeshSectionRenderData
+{
+public:
+	/* Positions, one FVector per vertex*/
+	FDeformMeshVertexBuffer PositionBuffer;
+	/* Texture coordinates, NumTexCoords FVector2DHalf (or FVector2D with full precision) per vertex*/
+	FDeformMeshVertexBuffer TexCoordBuffer;
+	/* Indices, 16 or 32 bits*/
+	FDeformMeshIndexBuffer IndexBuffer;
+
+	uint32 NumVertices = 0;
+	uint32 NumTexCoords = 0;
+	bool bFullPrecisionUVs = false;
+
+	/* Create a new render data, the returned pointer releases the render resources on the render thread when it's destroyed*/
+	static TSharedPtr<FDeformMeshSectionRenderData, ESPMode::ThreadSafe> Create()
+	{
+		return MakeRenderThreadReleasedPtr(new FDeformMeshSectionRenderData());
+	}
+
+	/* Enqueue the initialization of the buffers*/
+	void BeginInitResources()
+	{
+		BeginInitResource(&PositionBuffer);
+		BeginInitResource(&TexCoordBuffer);
+		BeginInitResource(&IndexBuffer);
+	}
+
+	/* Set generated geometry as the source of the buffers, the arrays are moved in and the buffers read them in place*/
+	void SetGeneratedGeometry(TArray<FVector>&& Positions, TArray<FVector2D>&& TexCoords, TArray<uint32>&& Indices)
+	{
+		GeneratedPositions = MoveTemp(Positions);
+		GeneratedTexCoords = MoveTemp(TexCoords);
+		GeneratedIndices = MoveTemp(Indices);
+		NumVertices = GeneratedPositions.Num();
+		NumTexCoords = 1;
+		bFullPrecisionUVs = true;
+		PositionBuffer.SetSource(new FDeformMeshResourceArrayView(GeneratedPositions.GetData(), GeneratedPositions.Num() * sizeof(FVector)), sizeof(FVector), PF_R32_FLOAT);
+		TexCoordBuffer.SetSource(new FDeformMeshResourceArrayView(GeneratedTexCoords.GetData(), GeneratedTexCoords.Num() * sizeof(FVector2D)), sizeof(FVector2D), PF_G32R32F);
+		IndexBuffer.SetSource(new FDeformMeshResourceArrayView(GeneratedIndices.GetData(), GeneratedIndices.Num() * sizeof(uint32)), sizeof(uint32));
+	}
+
+	/* Rewrite a range of the positions in place, only that range is uploaded. The buffer is static, so a partial lock doesn't discard the rest of it*/
+	void UpdatePositions_RenderThread(uint32 FirstVertex, const TArray<FVector>& Positions)
+	{
+		check(IsInRenderingThread());
+		check(FirstVertex + (uint32)Positions.Num() <= NumVertices);
+
+		//The CPU copy gets the new positions too, so a buffer created again from it doesn't go back to the old ones
+		if (GeneratedPositions.Num() > 0 && Positions.Num() > 0)
+		{
+			FMemory::Memcpy(&GeneratedPositions[FirstVertex], Positions.GetData(), Positions.Num() * sizeof(FVector));
+		}
+
+		if (PositionBuffer.VertexBufferRHI && Positions.Num() > 0)
+		{
+			const uint32 UploadSize = Positions.Num() * sizeof(FVector);
+			void* BufferData = RHILockVertexBuffer(PositionBuffer.VertexBufferRHI, FirstVertex * sizeof(FVector), UploadSize, RLM_WriteOnly);
+			FMemory::Memcpy(BufferData, Positions.GetData(), UploadSize);
+			RHIUnlockVertexBuffer(PositionBuffer.VertexBufferRHI);
+		}
+	}
+
+	/* Fill the vertex factory data with the stream components of our buffers, the same way the static mesh vertex buffers bind themselves*/
+	void BindVertexFactoryData(FLocalVertexFactory::FDataType& Data) const
+	{
+		Data.PositionComponent = FVertexStreamComponent(&PositionBuffer, 0, sizeof(FVector), VET_Float3);
+		Data.PositionComponentSRV = PositionBuffer.GetSRV();
+		Data.TextureCoordinatesSRV = TexCoordBuffer.GetSRV();
+
+		//We don't have tangents, but the vertex factory always reads them (From the packed tangents buffer with manual vertex fetch), so every vertex reads the one element of the null buffer
+		Data.TangentsSRV = GNullColorVertexBuffer.VertexBufferSRV;
+		Data.TangentBasisComponents[0] = FVertexStreamComponent(&GNullColorVertexBuffer, 0, 0, VET_PackedNormal, EVertexStreamUsage::ManualFetch);
+		Data.TangentBasisComponents[1] = FVertexStreamComponent(&GNullColorVertexBuffer, 0, 0, VET_PackedNormal, EVertexStreamUsage::ManualFetch);
+
+		const uint32 UVSize = bFullPrecisionUVs ? sizeof(FVector2D) : sizeof(FVector2DHalf);
+		const uint32 UVStride = UVSize * NumTexCoords;
+		const EVertexElementType UVDoubleType = bFullPrecisionUVs ? VET_Float4 : VET_Half4;
+		const EVertexElementType UVSingleType = bFullPrecisionUVs ? VET_Float2 : VET_Half2;
+
+		//Two texture coordinates are packed in one stream component, and the last one gets its own if the count is odd
+		Data.TextureCoordinates.Empty();
+		int32 UVIndex = 0;
+		for (; UVIndex < (int32)NumTexCoords - 1; UVIndex += 2)
+		{
+			Data.TextureCoordinates.Add(FVertexStreamComponent(&TexCoordBuffer, UVSize * UVIndex, UVStride, UVDoubleType, EVertexStreamUsage::ManualFetch));
+		}
+		if (UVIndex < (int32)NumTexCoords)
+		{
+			Data.TextureCoordinates.Add(FVertexStreamComponent(&TexCoordBuffer, UVSize * UVIndex, UVStride, UVSingleType, EVertexStreamUsage::ManualFetch));
+		}
+		Data.NumTexCoords = NumTexCoords;
+	}
+
+private:
+	/* The geometry of a generated section, it's kept so the buffers can be created again when the RHI resources are recreated (For example when the feature level changes)*/
+	/* An asset section doesn't have any, its buffers read the payload of the asset*/
+	TArray<FVector> GeneratedPositions;
+	TArray<FVector2D> GeneratedTexCoords;
+	TArray<uint32> GeneratedIndices;
+
+	FDeformMeshSectionRenderData() {}
+
+	void ReleaseResources_RenderThread()
+	{
+		PositionBuffer.ReleaseResource();
+		TexCoordBuffer.ReleaseResource();
+		IndexBuffer.ReleaseResource();
+	}
+
+	template<typename RenderDataType>
+	friend TSharedPtr<RenderDataType, ESPMode::ThreadSafe> MakeRenderThreadReleasedPtr(RenderDataType* RenderData);
+};
+
+typedef TSharedPtr<FDeformMeshSectionRenderData, ESPMode::ThreadSafe> FDeformMeshSectionRenderDataPtr;
+
+
+///////////////////////////////////////////////////////////////////////
+// The Deform Mesh Frozen Render Data
+/*
+ * The positions of a frozen section (See UDeformMeshComponent::FreezeMeshSection), deformed once on the CPU by a task graph worker
+ * The section is then drawn as a plain static mesh with these positions, it's kept by the game thread section so the scene proxy can be rebuilt without deforming again
+*/
+///////////////////////////////////////////////////////////////////////
+class FDeformMeshFrozenRenderData
+{
+public:
+	/* The deformed positions in the local space of the component, only filled once the freeze task is complete*/
+	FPositionVertexBuffer PositionBuffer;
+	/* The deform weights of a section that reads them from a texture coordinate channel, bound as the vertex color like they are before the section is frozen*/
+	FColorVertexBuffer WeightBuffer;
+	/* The task that deforms the positions*/
+	FGraphEventRef FreezeTask;
+
+	/* Create a new render data, the returned pointer releases the render resources on the render thread when it's destroyed*/
+	static TSharedPtr<FDeformMeshFrozenRenderData, ESPMode::ThreadSafe> Create()
+	{
+		return MakeRenderThreadReleasedPtr(new FDeformMeshFrozenRenderData());
+	}
+
+	/* Whether the freeze task is done, nothing but the task touches the buffers before that*/
+	bool IsFrozen() const
+	{
+		return !FreezeTask.IsValid() || FreezeTask->IsComplete();
+	}
+
+private:
+	FDeformMeshFrozenRenderData() {}
+
+	void ReleaseResources_RenderThread()
+	{
+		//The task owns the buffer until it's complete
+		if (FreezeTask.IsValid() && !FreezeTask->IsComplete())
+		{
+			FTaskGraphInterface::Get().WaitUntilTaskCompletes(FreezeTask, ENamedThreads::GetRenderThread_Local());
+		}
+		PositionBuffer.ReleaseResource();
+		WeightBuffer.ReleaseResource();
+	}
+
+	template<typename RenderDataType>
+	friend TSharedPtr<RenderDataType, ESPMode::ThreadSafe> MakeRenderThreadReleasedPtr(RenderDataType* RenderData);
+};
+
+typedef TSharedPtr<FDeformMeshFrozenRenderData, ESPMode::ThreadSafe> FDeformMeshFrozenRenderDataPtr;
+
+
+///////////////////////////////////////////////////////////////////////
+// The Deform Mesh Animation Render Data
+/*
+ * The GPU data of a baked deform animation (See UDeformMeshAnimation)
+ * The offsets of all the frames are in one buffer, the shader picks the two frames to blend with the vertex id, so nothing is uploaded while the animation plays
+*/
+///////////////////////////////////////////////////////////////////////
+class FDeformMeshAnimationRenderData
+{
+public:
+	/* Quantized local space offsets, 4 int16 (The last one is padding) per vertex per frame, read as normalized floats*/
+	FDeformMeshVertexBuffer OffsetsBuffer;
+	/* The scale that brings the normalized offsets of a frame back to their size, one float per frame*/
+	FDeformMeshVertexBuffer ScalesBuffer;
+
+	uint32 NumVertices = 0;
+	uint32 NumFrames = 0;
+	/* Number of baked frames per second of playback*/
+	float FrameRate = 30.f;
+
+	/* Create a new render data, the returned pointer releases the render resources on the render thread when it's destroyed*/
+	static TSharedPtr<FDeformMeshAnimationRenderData, ESPMode::ThreadSafe> Create()
+	{
+		return MakeRenderThreadReleasedPtr(new FDeformMeshAnimationRenderData());
+	}
+
+	/* Enqueue the initialization of the buffers*/
+	void BeginInitResources()
+	{
+		BeginInitResource(&OffsetsBuffer);
+		BeginInitResource(&ScalesBuffer);
+	}
+
+	/* Find the two frames to blend at a time of the animation (in seconds), looping or holding the last frame*/
+	void GetFramesAtTime(float Time, bool bLoop, uint32& OutFrameA, uint32& OutFrameB, float& OutAlpha) const
+	{
+		float Frame = Time * FrameRate;
+		if (bLoop)
+		{
+			Frame = FMath::Fmod(Frame, (float)NumFrames);
+			Frame = Frame < 0.f ? Frame + NumFrames : Frame;
+		}
+		else
+		{
+			Frame = FMath::Clamp(Frame, 0.f, (float)(NumFrames - 1));
+		}
+
+		OutFrameA = FMath::Min((uint32)Frame, NumFrames - 1);
+		OutAlpha = Frame - OutFrameA;
+		OutFrameB = OutFrameA + 1 < NumFrames ? OutFrameA + 1 : (bLoop ? 0 : OutFrameA);
+	}
+
+private:
+	FDeformMeshAnimationRenderData() {}
+
+	void ReleaseResources_RenderThread()
+	{
+		OffsetsBuffer.ReleaseResource();
+		ScalesBuffer.ReleaseResource();
+	}
+
+	template<typename RenderDataType>
+	friend TSharedPtr<RenderDataType, ESPMode::ThreadSafe> MakeRenderThreadReleasedPtr(RenderDataType* RenderData);
+};
+
+typedef TSharedPtr<FDeformMeshAnimationRenderData, ESPMode::ThreadSafe> FDeformMeshAnimationRenderDataPtr;
@@ -0,0 +1,60 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "DeformMeshSettings.h"
+#include "Materials/MaterialInterface.h"
+#include "Materials/MaterialInstance.h"
+
+UDeformMeshSettings::UDeformMeshSettings()
+	: bCompileForMaskedMaterials(true)
+	, bCompileForTranslucentMaterials(true)
+	, bWarmupPSOsOnBeginPlay(false)
+	, WarmupFrames(2)
+	, DeformFieldCellSize(1000.f)
+{
+}
+
+bool UDeformMeshSettings::IsMaterialAllowed(const UMaterialInterface* Material) const
+{
+	if (AllowedMaterialPaths.Num() == 0)
+	{
+		return true;
+	}
+
+	//Walk up the instance chain, an instance of an allowed material is allowed too
+	while (Material)
+	{
+		if (AllowedMaterialPaths.Contains(FSoftObjectPath(Material)))
+		{
+			return true;
+		}
+		const UMaterialInstance* MaterialInstance = Cast<UMaterialInstance>(Material);
+		Material = MaterialInstance ? MaterialInstance->Parent : nullptr;
+	}
+	return false;
+}
+
+void UDeformMeshSettings::PostInitProperties()
+{
+	Super::PostInitProperties();
+	CacheAllowedMaterials();
+}
+
+#if WITH_EDITOR
+void UDeformMeshSettings::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	CacheAllowedMaterials();
+}
+#endif
+
+void UDeformMeshSettings::CacheAllowedMaterials()
+{
+	AllowedMaterialPaths.Reset();
+	for (const TSoftObjectPtr<UMaterialInterface>& AllowedMaterial : AllowedMaterials)
+	{
+		if (!AllowedMaterial.IsNull())
+		{
+			AllowedMaterialPaths.Add(AllowedMaterial.ToSoftObjectPath());
+		}
+	}
+}
@@ -0,0 +1,53 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+///////////////////////////////////////////////////////////////////////
+// Deform Mesh profiling
+/*
+ * Everything the deform mesh pipeline costs is reported in three places:
+ * 1 The "stat DeformMesh" group, for cycle counters and per frame counters
+ * 2 Unreal Insights, through cpu profiler trace scopes (Available in Test builds too)
+ * 3 The CSV profiler, under the DeformMesh category, so production captures (-csvCaptureFrames) contain the deform cost
+*/
+///////////////////////////////////////////////////////////////////////
+
+DECLARE_STATS_GROUP(TEXT("DeformMesh"), STATGROUP_DeformMesh, STATCAT_Advanced);
+
+//Cycle counters
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Section Transform"), STAT_DeformMesh_UpdateSectionTransform, STATGROUP_DeformMesh, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Finish Transforms Update"), STAT_DeformMesh_FinishTransformsUpdate, STATGROUP_DeformMesh, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Upload Transforms RT"), STAT_DeformMesh_UploadTransforms, STATGROUP_DeformMesh, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Create Scene Proxy"), STAT_DeformMesh_CreateSceneProxy, STATGROUP_DeformMesh, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Get Dynamic Mesh Elements"), STAT_DeformMesh_GetDynamicMeshElements, STATGROUP_DeformMesh, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Section Batches"), STAT_DeformMesh_GenerateSectionBatches, STATGROUP_DeformMesh, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Deform Field"), STAT_DeformMesh_UpdateDeformField, STATGROUP_DeformMesh, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Freeze Section"), STAT_DeformMesh_FreezeSection, STATGROUP_DeformMesh, );
+
+//Counters, the sections counter is an accumulator because it tracks the live section proxies, the others are reset every frame
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Sections"), STAT_DeformMesh_Sections, STATGROUP_DeformMesh, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Draws"), STAT_DeformMesh_Draws, STATGROUP_DeformMesh, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Transform Bytes Uploaded"), STAT_DeformMesh_TransformBytesUploaded, STATGROUP_DeformMesh, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Render Commands Enqueued"), STAT_DeformMesh_RenderCommands, STATGROUP_DeformMesh, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Proxy Rebuilds"), STAT_DeformMesh_ProxyRebuilds, STATGROUP_DeformMesh, );
+
+CSV_DECLARE_CATEGORY_EXTERN(DeformMesh);
+
+/* Times the enclosing scope in the stat group, in Insights and in the CSV profiler, Name must match one of the cycle stats above (without the STAT_DeformMesh_ prefix) */
+#define DEFORMMESH_SCOPED_TIMING(Name) \
+	SCOPE_CYCLE_COUNTER(STAT_DeformMesh_##Name); \
+	TRACE_CPUPROFILER_EVENT_SCOPE(DeformMesh_##Name); \
+	CSV_SCOPED_TIMING_STAT(DeformMesh, Name)
+
+/* Adds to one of the per frame counters above, both in the stat group and in the CSV profiler, it's a single statement so it can be used in an unbraced if */
+#define DEFORMMESH_COUNTER_ADD(Name, Amount) \
+	do \
+	{ \
+		INC_DWORD_STAT_BY(STAT_DeformMesh_##Name, Amount); \
+		CSV_CUSTOM_STAT(DeformMesh, Name, (int32)(Amount), ECsvCustomStatOp::Accumulate); \
+	} while (0)
@@ -0,0 +1,180 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "DeformMeshTransformPool.h"
+#include "DeformMeshStats.h"
+#include "RenderingThread.h"
+
+TGlobalResource<FDeformMeshTransformPool> GDeformMeshTransformPool;
+
+/* The smallest buffer that the pool creates, so the first proxies don't recreate it one after the other*/
+static constexpr uint32 MinPoolBufferCapacity = 4096;
+
+/* The dirty matrices are tracked by pages of this many matrices, a page is 4KB*/
+static constexpr uint32 MatricesPerDirtyPage = 64;
+
+/* Past this many ranges of dirty pages, the span from the first to the last dirty page is uploaded with a single lock instead*/
+static constexpr int32 MaxDirtyRangesPerFlush = 16;
+
+uint32 FDeformMeshTransformPool::Allocate(uint32 NumMatrices)
+{
+	check(IsInRenderingThread());
+	if (NumMatrices == 0)
+	{
+		return InvalidOffset;
+	}
+
+	//First fit in the holes left by the proxies that were removed
+	for (int32 RangeIdx = 0; RangeIdx < FreeRanges.Num(); RangeIdx++)
+	{
+		FFreeRange& Range = FreeRanges[RangeIdx];
+		if (Range.NumMatrices >= NumMatrices)
+		{
+			const uint32 Offset = Range.Offset;
+			Range.Offset += NumMatrices;
+			Range.NumMatrices -= NumMatrices;
+			if (Range.NumMatrices == 0)
+			{
+				FreeRanges.RemoveAt(RangeIdx);
+			}
+			return Offset;
+		}
+	}
+
+	//Otherwise the pool grows, the buffer is recreated on the next flush if it's too small
+	const uint32 Offset = PoolMatrices.Num();
+	PoolMatrices.AddUninitialized(NumMatrices);
+	return Offset;
+}
+
+void FDeformMeshTransformPool::Free(uint32 Offset, uint32 NumMatrices)
+{
+	check(IsInRenderingThread());
+	if (Offset == InvalidOffset || NumMatrices == 0)
+	{
+		return;
+	}
+	check(Offset + NumMatrices <= (uint32)PoolMatrices.Num());
+
+	//Insert the range in order and merge it with its neighbours
+	int32 InsertIdx = 0;
+	while (InsertIdx < FreeRanges.Num() && FreeRanges[InsertIdx].Offset < Offset)
+	{
+		InsertIdx++;
+	}
+	FreeRanges.Insert(FFreeRange{ Offset, NumMatrices }, InsertIdx);
+
+	if (InsertIdx + 1 < FreeRanges.Num() && FreeRanges[InsertIdx].Offset + FreeRanges[InsertIdx].NumMatrices == FreeRanges[InsertIdx + 1].Offset)
+	{
+		FreeRanges[InsertIdx].NumMatrices += FreeRanges[InsertIdx + 1].NumMatrices;
+		FreeRanges.RemoveAt(InsertIdx + 1);
+	}
+	if (InsertIdx > 0 && FreeRanges[InsertIdx - 1].Offset + FreeRanges[InsertIdx - 1].NumMatrices == FreeRanges[InsertIdx].Offset)
+	{
+		FreeRanges[InsertIdx - 1].NumMatrices += FreeRanges[InsertIdx].NumMatrices;
+		FreeRanges.RemoveAt(InsertIdx);
+	}
+
+	//A free range at the end of the pool just shrinks it, the buffer keeps its size
+	const FFreeRange& Last = FreeRanges.Last();
+	if (Last.Offset + Last.NumMatrices == (uint32)PoolMatrices.Num())
+	{
+		//The dirty pages past the end are skipped by the next flush
+		PoolMatrices.SetNum(Last.Offset, false);
+		FreeRanges.Pop(false);
+	}
+}
+
+void FDeformMeshTransformPool::Write(uint32 Offset, const FMatrix* Matrices, uint32 NumMatrices)
+{
+	check(IsInRenderingThread());
+	check(Offset + NumMatrices <= (uint32)PoolMatrices.Num());
+	if (NumMatrices == 0)
+	{
+		return;
+	}
+
+	FMemory::Memcpy(&PoolMatrices[Offset], Matrices, NumMatrices * sizeof(FMatrix));
+	const int32 FirstPage = Offset / MatricesPerDirtyPage;
+	const int32 LastPage = (Offset + NumMatrices - 1) / MatricesPerDirtyPage;
+	if (DirtyPages.Num() <= LastPage)
+	{
+		DirtyPages.Add(false, LastPage + 1 - DirtyPages.Num());
+	}
+	DirtyPages.SetRange(FirstPage, LastPage - FirstPage + 1, true);
+}
+
+void FDeformMeshTransformPool::Flush_RenderThread()
+{
+	check(IsInRenderingThread());
+	const uint32 NumMatrices = PoolMatrices.Num();
+	if (NumMatrices == 0)
+	{
+		DirtyPages.Reset();
+		return;
+	}
+
+	DEFORMMESH_SCOPED_TIMING(UploadTransforms);
+	//A range of dirty pages, in pages
+	struct FDirtyRange
+	{
+		uint32 BeginPage;
+		uint32 EndPage;
+	};
+	TArray<FDirtyRange, TInlineAllocator<MaxDirtyRangesPerFlush>> DirtyRanges;
+
+	if (NumMatrices > BufferCapacity)
+	{
+		//The buffer grows by powers of two, and the whole pool is uploaded to the new one
+		BufferCapacity = FMath::Max(FMath::RoundUpToPowerOfTwo(NumMatrices), MinPoolBufferCapacity);
+		FRHIResourceCreateInfo CreateInfo;
+		//Set the debug name so we can find the resource when debugging in RenderDoc
+		CreateInfo.DebugName = TEXT("DeformMesh_TransformPool");
+		Buffer = RHICreateStructuredBuffer(sizeof(FMatrix), BufferCapacity * sizeof(FMatrix), BUF_ShaderResource, CreateInfo);
+		BufferSRV = RHICreateShaderResourceView(Buffer);
+		DirtyRanges.Add(FDirtyRange{ 0, FMath::DivideAndRoundUp(NumMatrices, MatricesPerDirtyPage) });
+	}
+	else
+	{
+		//Coalesce the consecutive dirty pages, the pages past the end of the pool were freed after they were written
+		const uint32 NumPages = FMath::DivideAndRoundUp(NumMatrices, MatricesPerDirtyPage);
+		for (TConstSetBitIterator<> It(DirtyPages); It && (uint32)It.GetIndex() < NumPages; ++It)
+		{
+			const uint32 Page = It.GetIndex();
+			if (DirtyRanges.Num() > 0 && DirtyRanges.Last().EndPage == Page)
+			{
+				DirtyRanges.Last().EndPage = Page + 1;
+			}
+			else
+			{
+				DirtyRanges.Add(FDirtyRange{ Page, Page + 1 });
+			}
+		}
+
+		//Past a few locks, copying the clean pages in between again from the CPU copy is cheaper than locking for each range
+		if (DirtyRanges.Num() > MaxDirtyRangesPerFlush)
+		{
+			DirtyRanges[0].EndPage = DirtyRanges.Last().EndPage;
+			DirtyRanges.SetNum(1);
+		}
+	}
+
+	for (const FDirtyRange& Range : DirtyRanges)
+	{
+		const uint32 Begin = Range.BeginPage * MatricesPerDirtyPage;
+		const uint32 End = FMath::Min(Range.EndPage * MatricesPerDirtyPage, NumMatrices);
+		const uint32 UploadSize = (End - Begin) * sizeof(FMatrix);
+		void* BufferData = RHILockStructuredBuffer(Buffer, Begin * sizeof(FMatrix), UploadSize, RLM_WriteOnly);
+		FMemory::Memcpy(BufferData, &PoolMatrices[Begin], UploadSize);
+		RHIUnlockStructuredBuffer(Buffer);
+		DEFORMMESH_COUNTER_ADD(TransformBytesUploaded, UploadSize);
+	}
+	DirtyPages.Reset();
+}
+
+void FDeformMeshTransformPool::ReleaseRHI()
+{
+	//The CPU copy is kept, so the next flush creates the buffer again and uploads all of it
+	Buffer.SafeRelease();
+	BufferSRV.SafeRelease();
+	BufferCapacity = 0;
+}
@@ -0,0 +1,68 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RenderResource.h"
+#include "RHI.h"
+
+///////////////////////////////////////////////////////////////////////
+// The Deform Mesh Transform Pool
+/*
+ * One structured buffer that holds the deform transforms and the spline slots of every deform mesh scene proxy
+ * Each proxy allocates a range of matrices when it's added to the scene, and writes its updates to the CPU copy of the pool
+ * The dirty matrices of all the proxies are uploaded together before the first deform mesh is drawn in a frame, one lock per range of dirty pages
+ * Everything here is only used on the render thread
+*/
+///////////////////////////////////////////////////////////////////////
+class FDeformMeshTransformPool : public FRenderResource
+{
+public:
+	/* Returned by Allocate() when nothing was allocated*/
+	static constexpr uint32 InvalidOffset = MAX_uint32;
+
+	/* Allocate a range of matrices, returns the index of its first matrix. The content of the range is undefined until it's written*/
+	uint32 Allocate(uint32 NumMatrices);
+
+	/* Give back a range allocated with Allocate()*/
+	void Free(uint32 Offset, uint32 NumMatrices);
+
+	/* Write matrices in an allocated range, they're uploaded with the next flush*/
+	void Write(uint32 Offset, const FMatrix* Matrices, uint32 NumMatrices);
+
+	/* Upload the dirty matrices of all the proxies, the buffer is recreated first if the pool outgrew it*/
+	void Flush_RenderThread();
+
+	/* The SRV of the pool's buffer, that the deform mesh vertex factory binds as DMTransforms*/
+	FShaderResourceViewRHIRef& GetSRV() { return BufferSRV; }
+
+	//~ Begin FRenderResource Interface.
+	virtual void ReleaseRHI() override;
+	virtual FString GetFriendlyName() const override { return TEXT("FDeformMeshTransformPool"); }
+	//~ End FRenderResource Interface.
+
+private:
+	/* A range of free matrices*/
+	struct FFreeRange
+	{
+		uint32 Offset;
+		uint32 NumMatrices;
+	};
+
+	/* The CPU copy of the whole pool, the buffer is recreated from it when it grows*/
+	TArray<FMatrix> PoolMatrices;
+
+	/* The free ranges below the end of the pool, sorted by offset and never adjacent to each other*/
+	TArray<FFreeRange> FreeRanges;
+
+	/* The GPU copy of the pool, it can be bigger than the pool so it doesn't need to be recreated every time a proxy is added*/
+	FStructuredBufferRHIRef Buffer;
+	FShaderResourceViewRHIRef BufferSRV;
+	uint32 BufferCapacity = 0;
+
+	/* The pages of matrices written since the last flush, the consecutive dirty pages are uploaded with a single lock*/
+	TBitArray<> DirtyPages;
+};
+
+/* The transform pool shared by all the deform mesh scene proxies of all the scenes*/
+extern TGlobalResource<FDeformMeshTransformPool> GDeformMeshTransformPool;
@@ -0,0 +1,207 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "DeformMeshTransformReplay.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/Paths.h"
+#include "RenderingThread.h"
+#include "UObject/UObjectIterator.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogDeformMeshReplay, Log, All);
+
+FDeformMeshTransformReplay::FDeformMeshTransformReplay()
+	: FirstFrame(nullptr)
+	, CurrentFrame(nullptr)
+	, End(nullptr)
+	, NumFrames(0)
+{
+}
+
+FDeformMeshTransformReplay::~FDeformMeshTransformReplay()
+{
+	Close();
+}
+
+bool FDeformMeshTransformReplay::Open(const FString& Filename)
+{
+	Close();
+
+	MappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Filename));
+	if (!MappedFile.IsValid())
+	{
+		UE_LOG(LogDeformMeshReplay, Warning, TEXT("Can't memory map %s"), *Filename);
+		return false;
+	}
+
+	const int64 FileSize = MappedFile->GetFileSize();
+	if (FileSize < (int64)sizeof(FDeformMeshTransformStreamHeader))
+	{
+		UE_LOG(LogDeformMeshReplay, Warning, TEXT("%s is too small to be a transform stream"), *Filename);
+		Close();
+		return false;
+	}
+
+	MappedRegion.Reset(MappedFile->MapRegion(0, FileSize));
+	if (!MappedRegion.IsValid())
+	{
+		UE_LOG(LogDeformMeshReplay, Warning, TEXT("Can't map the content of %s"), *Filename);
+		Close();
+		return false;
+	}
+
+	const uint8* Begin = MappedRegion->GetMappedPtr();
+	const FDeformMeshTransformStreamHeader* Header = reinterpret_cast<const FDeformMeshTransformStreamHeader*>(Begin);
+	if (Header->Magic != FDeformMeshTransformStreamHeader::ExpectedMagic || Header->Version != FDeformMeshTransformStreamHeader::ExpectedVersion)
+	{
+		UE_LOG(LogDeformMeshReplay, Warning, TEXT("%s is not a transform stream, or was recorded with another version"), *Filename);
+		Close();
+		return false;
+	}
+
+	End = Begin + MappedRegion->GetMappedSize();
+
+	//Count the complete frames and validate their records once here, so replaying them later never has to
+	const uint8* Frame = Begin + sizeof(FDeformMeshTransformStreamHeader);
+	NumFrames = 0;
+	while (IsCompleteFrame(Frame))
+	{
+		const uint32 NumUpdates = reinterpret_cast<const FDeformMeshTransformStreamFrame*>(Frame)->NumUpdates;
+		const FDeformMeshTransformUpdate* Updates = reinterpret_cast<const FDeformMeshTransformUpdate*>(Frame + sizeof(FDeformMeshTransformStreamFrame));
+		for (uint32 UpdateIdx = 0; UpdateIdx < NumUpdates; UpdateIdx++)
+		{
+			if (Updates[UpdateIdx].SectionIndex < 0 || Updates[UpdateIdx].DeformTransform.ContainsNaN())
+			{
+				UE_LOG(LogDeformMeshReplay, Warning, TEXT("%s has an invalid record in frame %d (Section index %d)"), *Filename, NumFrames, Updates[UpdateIdx].SectionIndex);
+				Close();
+				return false;
+			}
+		}
+
+		Frame += sizeof(FDeformMeshTransformStreamFrame) + NumUpdates * sizeof(FDeformMeshTransformUpdate);
+		NumFrames++;
+	}
+
+	if (NumFrames == 0)
+	{
+		UE_LOG(LogDeformMeshReplay, Warning, TEXT("%s doesn't contain any frame"), *Filename);
+		Close();
+		return false;
+	}
+
+	//Ignore a truncated last frame, if the recording wasn't stopped properly
+	End = Frame;
+	FirstFrame = Begin + sizeof(FDeformMeshTransformStreamHeader);
+	CurrentFrame = FirstFrame;
+	return true;
+}
+
+void FDeformMeshTransformReplay::Close()
+{
+	//The render thread reads the applied frames in place, so it must be done with them before they're unmapped
+	if (MappedRegion.IsValid() && FirstFrame != nullptr)
+	{
+		FlushRenderingCommands();
+	}
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	FirstFrame = nullptr;
+	CurrentFrame = nullptr;
+	End = nullptr;
+	NumFrames = 0;
+}
+
+bool FDeformMeshTransformReplay::IsCompleteFrame(const uint8* Frame) const
+{
+	if (End - Frame < (int64)sizeof(FDeformMeshTransformStreamFrame))
+	{
+		return false;
+	}
+	//Compare counts rather than pointers, so a corrupted NumUpdates can't overflow the address
+	const uint32 NumUpdates = reinterpret_cast<const FDeformMeshTransformStreamFrame*>(Frame)->NumUpdates;
+	return (uint64)(End - Frame - sizeof(FDeformMeshTransformStreamFrame)) / sizeof(FDeformMeshTransformUpdate) >= NumUpdates;
+}
+
+void FDeformMeshTransformReplay::GetCurrentFrameUpdates(const FDeformMeshTransformUpdate*& OutUpdates, int32& OutNumUpdates) const
+{
+	if (!IsOpen())
+	{
+		OutUpdates = nullptr;
+		OutNumUpdates = 0;
+		return;
+	}
+
+	const FDeformMeshTransformStreamFrame* Frame = reinterpret_cast<const FDeformMeshTransformStreamFrame*>(CurrentFrame);
+	OutUpdates = reinterpret_cast<const FDeformMeshTransformUpdate*>(CurrentFrame + sizeof(FDeformMeshTransformStreamFrame));
+	OutNumUpdates = Frame->NumUpdates;
+}
+
+void FDeformMeshTransformReplay::ApplyCurrentFrame(UDeformMeshComponent* Component) const
+{
+	if (!IsOpen() || !Component)
+	{
+		return;
+	}
+
+	const FDeformMeshTransformUpdate* Updates;
+	int32 NumUpdates;
+	GetCurrentFrameUpdates(Updates, NumUpdates);
+
+	Component->UpdateMeshSectionTransformsInPlace(Updates, NumUpdates);
+	Component->FinishTransformsUpdate();
+}
+
+void FDeformMeshTransformReplay::AdvanceFrame()
+{
+	if (!IsOpen())
+	{
+		return;
+	}
+
+	const FDeformMeshTransformStreamFrame* Frame = reinterpret_cast<const FDeformMeshTransformStreamFrame*>(CurrentFrame);
+	CurrentFrame += sizeof(FDeformMeshTransformStreamFrame) + Frame->NumUpdates * sizeof(FDeformMeshTransformUpdate);
+	if (CurrentFrame >= End)
+	{
+		CurrentFrame = FirstFrame;
+	}
+}
+
+
+///////////////////////////////////////////////////////////////////////
+// Recording production sessions
+/*
+ * DeformMesh.RecordTransforms Start [Directory] starts recording every deform mesh component of the world to its own file
+ * DeformMesh.RecordTransforms Stop stops all of them
+*/
+///////////////////////////////////////////////////////////////////////
+static void RecordDeformTransforms(const TArray<FString>& Args, UWorld* World)
+{
+	const bool bStart = Args.Num() > 0 && Args[0] == TEXT("Start");
+	const FString Directory = Args.Num() > 1 ? Args[1] : FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("DeformMeshTransforms"));
+
+	for (TObjectIterator<UDeformMeshComponent> It; It; ++It)
+	{
+		UDeformMeshComponent* Component = *It;
+		if (Component->GetWorld() != World)
+		{
+			continue;
+		}
+
+		if (bStart)
+		{
+			const FString Filename = FPaths::Combine(Directory, Component->GetOwner() ? Component->GetOwner()->GetName() + TEXT(".") + Component->GetName() : Component->GetName()) + TEXT(".dmtransforms");
+			Component->StartRecordingTransforms(Filename);
+		}
+		else
+		{
+			Component->StopRecordingTransforms();
+		}
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs GDeformMeshRecordTransformsCommand(
+	TEXT("DeformMesh.RecordTransforms"),
+	TEXT("Start [Directory] | Stop. Records the transform updates of every deform mesh component of the world, one file per component."),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RecordDeformTransforms));
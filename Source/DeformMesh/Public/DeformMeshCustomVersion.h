@@ -0,0 +1,35 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/Guid.h"
+
+///////////////////////////////////////////////////////////////////////
+// The Deform Mesh Custom Version
+/*
+ * Version of the deform mesh data saved in packages, PostLoad() uses it to migrate the data saved by older versions of the plugin
+ * Add new versions right before VersionPlusOne, never change or remove the existing ones
+*/
+///////////////////////////////////////////////////////////////////////
+struct DEFORMMESH_API FDeformMeshCustomVersion
+{
+	enum Type
+	{
+		// Before any version changes were made in the plugin
+		BeforeCustomVersionWasAdded = 0,
+
+		// The deform transform and the local box of the sections moved to the component's SectionDeformTransforms and SectionLocalBoxes arrays
+		SectionDataInParallelArrays,
+
+		// -----<new versions can be added above this line>-------------------------------------------------
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	// The GUID for this custom version number
+	const static FGuid GUID;
+
+private:
+	FDeformMeshCustomVersion() {}
+};
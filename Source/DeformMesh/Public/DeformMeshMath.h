@@ -0,0 +1,116 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SplineMeshComponent.h"
+
+///////////////////////////////////////////////////////////////////////
+// The Deform Mesh CPU Math
+/*
+ * CPU versions of the deformations done by the vertex factory shader (See CalcDeformedWorldPosition in LocalVertexFactory.ush)
+ * Anything that needs to know where a vertex ends up without rendering it (Baking, freezing, picking) uses these, so it has to stay in sync with the shader
+*/
+///////////////////////////////////////////////////////////////////////
+struct FDeformMeshMath
+{
+	/** Distance from the deform origin at which a vertex is no longer deformed at all */
+	static constexpr float FalloffDistance = 100.f;
+
+	/**
+	 * Returns the world position of a vertex deformed by a deform transform
+	 * @param LocalPosition		The position of the vertex in the vertex buffer
+	 * @param LocalToWorld		The transform of the component
+	 * @param DeformTransform	The deform transform matrix, already transposed the same way it's stored in the section
+	 * @param Weight			The deform weight of the vertex, 0 pins it where it is
+	 */
+	static FVector CalcDeformedWorldPosition(const FVector& LocalPosition, const FMatrix& LocalToWorld, const FMatrix& DeformTransform, float Weight = 1.f)
+	{
+		const FMatrix DeformMatrix = DeformTransform.GetTransposed();
+
+		//The original world position without deformation
+		const FVector OriginalPos = LocalToWorld.TransformPosition(LocalPosition);
+
+		//The fully deformed position, the deform transform without its translation
+		const FVector DeformedPos = DeformMatrix.TransformVector(LocalPosition);
+
+		//Distance between the vertex position and the deform transform origin, squared falloff
+		float d = FMath::Min(FVector::Distance(OriginalPos, DeformMatrix.GetOrigin()), FalloffDistance) / FalloffDistance;
+		d = d * d;
+		return FMath::Lerp(OriginalPos, DeformedPos, (1.f - d) * Weight);
+	}
+
+	/** Same as above, but returns the deformed position in the local space of the component */
+	static FVector CalcDeformedLocalPosition(const FVector& LocalPosition, const FMatrix& LocalToWorld, const FMatrix& WorldToLocal, const FMatrix& DeformTransform, float Weight = 1.f)
+	{
+		return WorldToLocal.TransformPosition(CalcDeformedWorldPosition(LocalPosition, LocalToWorld, DeformTransform, Weight));
+	}
+
+	/** Number of float4 spline parameters that the shader reads (See the SplineParams defines in LocalVertexFactory.ush) */
+	static constexpr int32 NumSplineParams = 10;
+
+	/** Returns the unit vector of an axis */
+	static FVector GetAxisMask(ESplineMeshAxis::Type Axis)
+	{
+		return Axis == ESplineMeshAxis::X ? FVector(1, 0, 0) : (Axis == ESplineMeshAxis::Y ? FVector(0, 1, 0) : FVector(0, 0, 1));
+	}
+
+	/**
+	 * Pack a spline the way the shader reads it, the same way the spline mesh components do
+	 * @param MeshBox	The local box of the mesh, its extent along the forward axis is mapped to the whole spline
+	 */
+	static void PackSplineParams(const FSplineMeshParams& Params, ESplineMeshAxis::Type ForwardAxis, const FVector& UpDir, const FBox& MeshBox, FVector4 OutSplineParams[NumSplineParams])
+	{
+		const FVector DirMask = GetAxisMask(ForwardAxis);
+		const float MeshMinZ = FVector::DotProduct(MeshBox.Min, DirMask);
+		const float MeshRangeZ = FVector::DotProduct(MeshBox.Max, DirMask) - MeshMinZ;
+		const float ScaleZ = MeshRangeZ > SMALL_NUMBER ? 1.f / MeshRangeZ : 0.f;
+
+		OutSplineParams[0] = FVector4(Params.StartPos, Params.StartRoll);
+		OutSplineParams[1] = FVector4(Params.StartTangent, Params.EndRoll);
+		OutSplineParams[2] = FVector4(Params.StartScale.X, Params.StartScale.Y, Params.StartOffset.X, Params.StartOffset.Y);
+		OutSplineParams[3] = FVector4(Params.EndPos, 0.f);
+		OutSplineParams[4] = FVector4(Params.EndTangent, MeshMinZ * ScaleZ);
+		OutSplineParams[5] = FVector4(Params.EndScale.X, Params.EndScale.Y, Params.EndOffset.X, Params.EndOffset.Y);
+		OutSplineParams[6] = FVector4(UpDir, ScaleZ);
+		OutSplineParams[7] = FVector4(DirMask, 0.f);
+		OutSplineParams[8] = FVector4(GetAxisMask((ESplineMeshAxis::Type)((ForwardAxis + 1) % 3)), 0.f);
+		OutSplineParams[9] = FVector4(GetAxisMask((ESplineMeshAxis::Type)((ForwardAxis + 2) % 3)), 0.f);
+	}
+
+	/** Returns the local position of a vertex bent along a packed spline, the CPU version of CalcSliceTransform() */
+	static FVector CalcSplineDeformedLocalPosition(const FVector& LocalPosition, const FVector4 SplineParams[NumSplineParams])
+	{
+		const FVector StartPos(SplineParams[0]);
+		const FVector StartTangent(SplineParams[1]);
+		const FVector EndPos(SplineParams[3]);
+		const FVector EndTangent(SplineParams[4]);
+		const FVector UpDir(SplineParams[6]);
+
+		//Find how far 'along' mesh we are
+		const float Alpha = FVector::DotProduct(LocalPosition, FVector(SplineParams[7])) * SplineParams[6].W - SplineParams[4].W;
+		const float HermiteAlpha = SplineParams[3].W != 0.f ? FMath::SmoothStep(0.f, 1.f, Alpha) : Alpha;
+
+		//The point and the direction of the spline at this point along
+		const float A2 = Alpha * Alpha;
+		const float A3 = A2 * Alpha;
+		FVector SplinePos = ((2 * A3) - (3 * A2) + 1) * StartPos + (A3 - (2 * A2) + Alpha) * StartTangent + (A3 - A2) * EndTangent + ((-2 * A3) + (3 * A2)) * EndPos;
+		const FVector C = (6 * StartPos) + (3 * StartTangent) + (3 * EndTangent) - (6 * EndPos);
+		const FVector D = (-6 * StartPos) - (4 * StartTangent) - (2 * EndTangent) + (6 * EndPos);
+		const FVector SplineDir = (C * A2 + D * Alpha + StartTangent).GetSafeNormal();
+
+		//Base frenet frame, offset and roll
+		const FVector BaseXVec = FVector::CrossProduct(UpDir, SplineDir).GetSafeNormal();
+		const FVector BaseYVec = FVector::CrossProduct(SplineDir, BaseXVec).GetSafeNormal();
+		const FVector2D SliceOffset = FMath::Lerp(FVector2D(SplineParams[2].Z, SplineParams[2].W), FVector2D(SplineParams[5].Z, SplineParams[5].W), HermiteAlpha);
+		SplinePos += SliceOffset.X * BaseXVec + SliceOffset.Y * BaseYVec;
+
+		float SinAng, CosAng;
+		FMath::SinCos(&SinAng, &CosAng, FMath::Lerp(SplineParams[0].W, SplineParams[1].W, HermiteAlpha));
+		const FVector2D UseScale = FMath::Lerp(FVector2D(SplineParams[2].X, SplineParams[2].Y), FVector2D(SplineParams[5].X, SplineParams[5].Y), HermiteAlpha);
+		const FVector XVec = ((CosAng * BaseXVec) - (SinAng * BaseYVec)) * UseScale.X;
+		const FVector YVec = ((CosAng * BaseYVec) + (SinAng * BaseXVec)) * UseScale.Y;
+
+		return SplinePos + FVector::DotProduct(LocalPosition, FVector(SplineParams[8])) * XVec + FVector::DotProduct(LocalPosition, FVector(SplineParams[9])) * YVec;
+	}
+};
@@ -0,0 +1,96 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/DeformMeshComponent.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+///////////////////////////////////////////////////////////////////////
+// Deform transform streams
+/*
+ * A transform stream is what UDeformMeshComponent::StartRecordingTransforms() writes:
+ * 1 One FDeformMeshTransformStreamHeader at the start of the file
+ * 2 Then one FDeformMeshTransformStreamFrame per recorded frame, each one directly followed by its NumUpdates FDeformMeshTransformUpdate records
+ * Everything is 16 bytes aligned, so the records can be used in place from a memory mapped file without copying or parsing them
+*/
+///////////////////////////////////////////////////////////////////////
+
+struct FDeformMeshTransformStreamHeader
+{
+	static constexpr uint32 ExpectedMagic = 0x4D464454; // 'TDFM'
+	static constexpr uint32 ExpectedVersion = 1;
+
+	uint32 Magic;
+	uint32 Version;
+	/** Only informative, a stream that wasn't closed properly still has 0 here, the frames are found by walking the file */
+	uint32 NumFrames;
+	uint32 Padding;
+};
+static_assert(sizeof(FDeformMeshTransformStreamHeader) == 16, "Transform stream records must stay 16 bytes aligned");
+
+struct FDeformMeshTransformStreamFrame
+{
+	/** Number of FDeformMeshTransformUpdate records that follow this frame header */
+	uint32 NumUpdates;
+	uint32 Padding[3];
+};
+static_assert(sizeof(FDeformMeshTransformStreamFrame) == 16, "Transform stream records must stay 16 bytes aligned");
+
+
+///////////////////////////////////////////////////////////////////////
+// The Deform Mesh Transform Replay
+/*
+ * Memory maps a recorded transform stream and feeds it frame by frame to deform mesh components
+ * The updates are passed to UpdateMeshSectionTransformsInPlace() straight from the mapped pages, and the render thread reads them there too
+ * So nothing is copied per frame, but closing the replay flushes the rendering commands before the file is unmapped
+ * The same frame can be applied to several components before advancing, which is how the benchmark replays one capture on a whole grid
+*/
+///////////////////////////////////////////////////////////////////////
+class DEFORMMESH_API FDeformMeshTransformReplay
+{
+public:
+	FDeformMeshTransformReplay();
+	~FDeformMeshTransformReplay();
+
+	/** Map the file and validate its header, returns false if the file can't be mapped or is not a transform stream */
+	bool Open(const FString& Filename);
+
+	/** Flush the rendering commands that may still read the mapped frames, and unmap the file */
+	void Close();
+
+	bool IsOpen() const { return FirstFrame != nullptr; }
+
+	/** Number of complete frames in the stream */
+	int32 GetNumFrames() const { return NumFrames; }
+
+	/** Get the updates of the current frame, they point into the mapped file and stay valid until the replay is closed */
+	void GetCurrentFrameUpdates(const FDeformMeshTransformUpdate*& OutUpdates, int32& OutNumUpdates) const;
+
+	/** Apply the updates of the current frame to the component and finish its transforms update */
+	void ApplyCurrentFrame(UDeformMeshComponent* Component) const;
+
+	/** Move to the next frame, loops back to the first frame at the end of the stream */
+	void AdvanceFrame();
+
+	/** Apply the current frame and advance */
+	void ReplayNextFrame(UDeformMeshComponent* Component)
+	{
+		ApplyCurrentFrame(Component);
+		AdvanceFrame();
+	}
+
+private:
+	/** Returns whether a complete frame starts at this address */
+	bool IsCompleteFrame(const uint8* Frame) const;
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	const uint8* FirstFrame;
+	const uint8* CurrentFrame;
+	const uint8* End;
+	int32 NumFrames;
+};